@@ -0,0 +1,37 @@
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <vector>
+
+#define ARENA_CHUNK (2 << 20) // One huge page on x86-64
+
+namespace chip8 {
+#pragma once
+// Bump allocator handing out memory from 2 MB chunks. On Linux the chunks are
+// aligned to 2 MB and marked for transparent huge pages, so thousands of
+// machines cost a handful of TLB entries instead of one per 4 KB.
+//
+// Pages land on the NUMA node of the thread that first touches them, so an
+// arena should be created and used by one pinned thread. Memory is only
+// given back when the arena goes away; recycle objects on top of it
+class Arena {
+  std::vector<std::pair<void *, size_t>> chunks;
+  uint8_t *cursor = nullptr;
+  size_t left = 0;
+
+public:
+  Arena() = default;
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+  ~Arena();
+
+  void *Allocate(size_t size, size_t align = 64);
+
+  // Only for trivially destructible types, nothing is ever destroyed
+  template <typename T, typename... Args> T *New(Args &&...args) {
+    return new (Allocate(sizeof(T), alignof(T) > 64 ? alignof(T) : 64))
+        T(std::forward<Args>(args)...);
+  }
+};
+} // namespace chip8
@@ -0,0 +1,77 @@
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "arena.hpp"
+#include "chip8.hpp"
+#include "input_script.hpp"
+#include "thread_pool.hpp"
+
+namespace chip8 {
+#pragma once
+struct BatchJob {
+  std::string rom;
+  uint32_t seed = 0;
+  std::string input;   // Input script, empty for none
+  uint64_t cycles = 0; // Cycle budget
+};
+
+// Why a run stopped before its cycle budget
+enum class HaltReason {
+  None,     // Ran the whole budget
+  SelfJump, // 1NNN onto itself with both timers at zero
+  KeyWait,  // Parked on FX0A with no input left to come
+};
+
+struct BatchResult {
+  bool loaded = false;      // The ROM and input script could be loaded
+  HaltReason halt = HaltReason::None;
+  uint64_t cycles = 0;      // Instructions executed
+  uint64_t frames = 0;      // 60Hz frames run
+  uint16_t pc = 0;          // Final program counter
+  uint32_t displayHash = 0; // FNV-1a of the final display
+  double micros = 0;        // Wall clock time of the run
+};
+
+// Reads "rom seed input cycles" lines, with '-' for no input script
+bool LoadBatchJobs(const std::string &filename, std::vector<BatchJob> &jobs);
+
+uint32_t DisplayHash(const Chip8 &c8);
+
+// Whether c8 can make no further progress. inputDone is true when no more
+// key events will ever arrive
+HaltReason Halted(const Chip8 &c8, bool inputDone);
+
+const char *HaltReasonName(HaltReason reason);
+
+// Runs many independent jobs across all cores. ROMs and input scripts are
+// read once, and every worker keeps a pool of machines it resets instead of
+// constructing new ones. Runs that halt stop early and hand their machine
+// back right away.
+//
+// Each worker's machines come from its own huge page arena, created on the
+// worker thread so the pages sit on its NUMA node when workers are pinned
+class Batch {
+  ThreadPool pool;
+  int cyclesPerFrame;
+
+  std::map<std::string, std::vector<uint8_t>> roms;
+  std::map<std::string, InputScript> scripts;
+
+  // Per worker, only ever touched by that worker
+  std::vector<std::unique_ptr<Arena>> arenas;
+  std::vector<std::vector<Chip8 *>> machines; // Free ones
+
+  Chip8 *acquire(int worker);
+  void release(int worker, Chip8 *c8);
+  void run(const BatchJob &job, BatchResult &result, int worker);
+
+public:
+  explicit Batch(int threads = 0, int cyclesPerFrame = 960 / 60,
+                 bool pin = false);
+
+  std::vector<BatchResult> Run(const std::vector<BatchJob> &jobs);
+};
+} // namespace chip8
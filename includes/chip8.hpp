@@ -4,6 +4,8 @@
 
 namespace chip8 {
 #pragma once
+class LatencyProbe;
+
 class Chip8 {
   uint8_t font[80] = {
       0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
@@ -24,20 +26,41 @@ class Chip8 {
       0xF0, 0x80, 0xF0, 0x80, 0x80, // F
   };
 
+  uint32_t rngState = 0x2545F491; // xorshift32 state, part of the snapshot so
+                                  // replaying a frame rolls the same numbers
+
+  // Notes a write to mem[address, address + size), size <= 64
+  void written(uint16_t address, int size) {
+    uint64_t pages = 1ull << ((address >> 6) & 63) |
+                     1ull << (((address + size - 1) >> 6) & 63);
+    dirtyPages |= pages & watchPages;
+  }
+
   void stackPush(uint16_t data);
   uint16_t stackPop();
+  uint8_t random();
 
 public:
   std::array<bool, 64 * 32> display; // State of the 64x32 monochrome display
   bool redraw = false; // Only redraw when requested. The display module must
                        // set it to false after drawing.
+  uint32_t dirtyRows = 0; // Display rows changed since the display module
+                          // last uploaded, bit per row. It clears them
 
   bool beep = true; // Signal the display that the system needs to "beep". The
                     // display module must set it to false after beeping
 
+  bool waitingForKey = false; // Set while FX0A is blocked on a keypress. The
+                              // driver can stop ticking until the keypad
+                              // changes, only the timers need to keep running
+
+  bool speculative = false; // Set while running frames that will be rolled
+                            // back. Suppresses side effects such as logging
+
   std::array<uint8_t, 4096> mem; // 4kb memory
 
-  std::array<bool, 16> keypadState; // State of the keypad (0 to F)
+  std::array<bool, 16> keypadState; // State of the keypad (0 to F). Prefer
+                                    // SetKey, it reports the event to probe
 
   std::array<uint8_t, 16> reg; // 16 registers (v0 to vF)
   uint16_t pc;                 // Program Counter
@@ -50,9 +73,30 @@ public:
   uint8_t delayTimer; // 8 bit delay timer
   uint8_t soundTimer; // 8 bit sound timer
 
+  uint64_t cycles = 0; // Instructions executed since the last reset
+
+  LatencyProbe *probe = nullptr; // Input latency instrumentation, optional
+
+  uint64_t watchPages = 0; // 64 byte pages of mem someone watches, bit per page
+  uint64_t dirtyPages = 0; // Watched pages written since the owner last looked
+  uint16_t bcdAddress = 0; // Where the last FX33 wrote its three digits. ROMs
+                           // usually move I right after (F265), so watches
+                           // on "the score at I" look here instead
+
+  // The whole machine is a flat, trivially copyable value. Snapshotting and
+  // restoring it is a plain copy:
+  //
+  //   Chip8 saved = interp;
+  //   ... run speculative frames ...
+  //   interp = saved;
+
   void Reset();
+  void Seed(uint32_t seed);
   bool LoadProgram(const std::string &filename);
+  bool LoadProgram(const uint8_t *program, size_t size);
+  void SetKey(uint8_t key, bool down);
   void Tick();
   void TickTimer();
+  int RunFrame(int budget);
 };
 } // namespace chip8
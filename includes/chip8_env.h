@@ -0,0 +1,95 @@
+#include <stddef.h>
+#include <stdint.h>
+
+#define CHIP8_ENV_WIDTH 64
+#define CHIP8_ENV_HEIGHT 32
+#define CHIP8_ENV_OBS_SIZE (CHIP8_ENV_WIDTH * CHIP8_ENV_HEIGHT)
+
+#ifdef _WIN32
+#ifdef CHIP8_ENV_BUILD
+#define CHIP8_ENV_API __declspec(dllexport)
+#else
+#define CHIP8_ENV_API __declspec(dllimport)
+#endif
+#else
+#define CHIP8_ENV_API __attribute__((visibility("default")))
+#endif
+
+#pragma once
+#ifdef __cplusplus
+extern "C" {
+#endif
+// C interface for stepping many machines from other languages (Python via
+// ctypes/cffi, etc). One call steps every instance, so the cost of crossing
+// the boundary is paid once per step, not once per instance.
+//
+// Observations are written straight into the caller's buffer, which holds
+// instances * chip8_env_obs_size(env) bytes. By default that is one 64x32
+// plane of bytes per instance, 0 or 1, row major. With frame_stack n it is
+// the last n frames, oldest first, and with CHIP8_ENV_OBS_FLOAT the planes
+// are floats (0.0 or 1.0) instead of bytes.
+// Actions are keypad bitmasks (bit i = key i held).
+//
+// Instances that finish an episode are reset inside chip8_env_step. Their
+// observation is then the first one of the new episode and out_done is set.
+typedef struct chip8_env chip8_env;
+
+typedef enum chip8_env_obs_format {
+  CHIP8_ENV_OBS_U8,    // uint8_t, 0 or 1
+  CHIP8_ENV_OBS_FLOAT, // float, 0.0 or 1.0
+} chip8_env_obs_format;
+
+typedef struct chip8_env_options {
+  int instances;        // Number of machines
+  int cycles_per_frame; // Instructions per 60Hz frame (default 16)
+  int frames_per_step;  // Frames run with the same action (default 1)
+  uint32_t seed;        // CXNN seed of instance i is seed + i
+  int threads;          // Worker threads, 0 or 1 to step on the caller's
+
+  // Reward is the change of the byte at reward_address since the last step
+  // (a score the ROM keeps in memory), -1 for always 0
+  int reward_address;
+
+  uint32_t max_steps; // Episode length limit, 0 for none
+
+  int obs_format;  // chip8_env_obs_format (default CHIP8_ENV_OBS_U8)
+  int frame_stack; // Frames per observation, one per step (default 1)
+
+  // Every stacked frame is the OR of a step's frame and the one before it,
+  // which hides sprites flickering while they move
+  int max_pool;
+} chip8_env_options;
+
+CHIP8_ENV_API void chip8_env_default_options(chip8_env_options *options);
+
+// NULL when the options are invalid, the ROM does not fit in memory or the
+// machines or worker threads can't be created
+CHIP8_ENV_API chip8_env *chip8_env_create(const uint8_t *rom, size_t size,
+                                          const chip8_env_options *options);
+
+CHIP8_ENV_API void chip8_env_destroy(chip8_env *env);
+
+// Bytes of one instance's observation
+CHIP8_ENV_API size_t chip8_env_obs_size(const chip8_env *env);
+
+// Starts a new episode on every instance. out_obs may be NULL
+CHIP8_ENV_API void chip8_env_reset(chip8_env *env, void *out_obs);
+
+// Steps every instance with actions[i]. out_obs, out_reward and out_done
+// hold one entry per instance, any of them may be NULL. Returns 0, or -1 if
+// env or actions is NULL
+CHIP8_ENV_API int chip8_env_step(chip8_env *env, const uint16_t *actions,
+                                 void *out_obs, float *out_reward,
+                                 uint8_t *out_done);
+
+// Adds a reward (done = 0) or termination (done = 1) predicate such as
+// "mem[0x2F0] changed", "v3 > 10" or "bcd[i] decreased", see watch.hpp.
+// A reward predicate adds reward every time it fires. Returns 0, or -1 if
+// the expression does not parse
+CHIP8_ENV_API int chip8_env_add_watch(chip8_env *env, const char *expression,
+                                      int done, float reward);
+
+CHIP8_ENV_API int chip8_env_instances(const chip8_env *env);
+#ifdef __cplusplus
+}
+#endif
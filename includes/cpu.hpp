@@ -0,0 +1,13 @@
+// AVX2 kernels are compiled for AVX2 function by function and picked at run
+// time, so one binary uses them where the CPU has them and runs everywhere
+// else. GCC and Clang on x86-64 only, other builds get the plain loops
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define CHIP8_AVX2_KERNELS 1
+#define CHIP8_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
+namespace chip8 {
+#pragma once
+// Whether the CPU we run on has AVX2. Asked once, then cached
+bool HasAVX2();
+} // namespace chip8
@@ -0,0 +1,61 @@
+#include <cstdint>
+#include <vector>
+
+#include <GLFW/glfw3.h>
+
+#include "gl_loader.hpp"
+#include "observation.hpp"
+
+namespace chip8 {
+#pragma once
+// Draws the display on the GPU. The frame goes up as an 8x32 R8UI texture,
+// one bit per pixel (256 bytes instead of 6 KB of RGB), and a fragment shader
+// looks up the bit, applies the palette and scales it into a texture ImGui
+// shows as is. Recoloring is one tiny draw, nothing is uploaded again.
+//
+// Needs GLSL 1.30 (integer textures, texelFetch). Init fails on anything
+// older, such as the GLES 2 builds, and the GUI keeps converting on the CPU
+class DisplayRenderer {
+  GLFunctions gl;
+
+  GLuint program = 0;
+  GLuint vao = 0;
+  GLuint framebuffer = 0;
+  GLuint bits = 0;   // 8x32 R8UI, pixel x of row y is bit x % 8 of (x / 8, y)
+  GLuint output = 0; // width x height RGB, what ImGui draws
+
+  int width = 0;
+  int height = 0;
+  int gridColumns = 1; // Displays in the bits texture, across and down
+  int gridRows = 1;
+  std::vector<uint8_t> atlas;
+
+  GLint fgLocation = -1;
+  GLint bgLocation = -1;
+  GLint originLocation = -1;
+  GLint scaleLocation = -1;
+
+  GLuint compile(GLenum type, const char *glslVersion, const char *source);
+  void draw(GLuint target, int x, int y, int width, int height, bool flip,
+            const float fg[3], const float bg[3]);
+
+public:
+  // glslVersion is the "#version ..." line the frontend hands to ImGui. With
+  // more than one column or row it draws a grid of displays, see UploadAtlas
+  bool Init(const char *glslVersion, int width, int height, int columns = 1,
+            int rows = 1);
+
+  void Upload(const PackedFrame frame, uint32_t rows); // Rows to update
+
+  // count packed frames back to back, frame i goes into cell i counting
+  // across first. The whole grid goes up in one call
+  void UploadAtlas(const uint64_t *frames, int count);
+  void Draw(const float fg[3], const float bg[3]); // Into Texture()
+
+  // Straight onto the window's framebuffer, x and y as for glViewport
+  void Present(int x, int y, int width, int height, const float fg[3],
+               const float bg[3]);
+
+  GLuint Texture() const { return output; }
+};
+} // namespace chip8
@@ -0,0 +1,111 @@
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "chip8_env.h"
+
+#define ENV_SERVER_SLOTS 4          // Steps a client may have in flight
+#define ENV_SERVER_MAGIC 0x32453843 // "C8E2", bumped with the layout
+#define ENV_SERVER_POLL_MS 100 // How often a waiting client checks the server
+
+namespace chip8 {
+#pragma once
+// chip8_env served over shared memory to trainers in other processes, Linux
+// only. The segment is a header followed by ENV_SERVER_SLOTS slots:
+//
+//   u32 command
+//   u16 actions[instances]
+//   f32 reward[instances]
+//   u8  done[instances]
+//   u8  obs[instances * obsSize]
+//
+// Observations are laid out as chip8_env writes them, the server's options
+// pick the format and the header tells the client.
+// The client fills a slot's actions in place and bumps head, the server steps
+// straight into the slot's outputs and bumps tail. Both sides sleep on those
+// two counters with futexes. The displays are the only thing ever copied.
+// One client at a time.
+//
+// The server holds an exclusive flock on the segment for as long as it runs,
+// the kernel drops it however the server dies. A waiting client wakes up
+// every ENV_SERVER_POLL_MS to look, so it doesn't hang on a dead server.
+enum class EnvCommand : uint32_t { Step, Reset, Stop };
+
+struct EnvRingHeader {
+  std::atomic<uint32_t> magic; // Set once the server is ready
+  uint32_t instances;
+  uint32_t slotSize;
+  uint32_t obsFormat; // chip8_env_obs_format
+  uint32_t obsDepth;  // Stacked frames per observation
+  uint32_t obsSize;   // Bytes per instance
+  std::atomic<uint32_t> head;      // Requests submitted by the client
+  std::atomic<uint32_t> tail;      // Requests completed by the server
+  std::atomic<uint64_t> stepNanos; // Time spent stepping, for latency splits
+};
+
+// Pointers into one slot
+struct EnvSlot {
+  uint32_t *command;
+  uint16_t *actions;
+  float *reward;
+  uint8_t *done;
+  uint8_t *obs;
+};
+
+class EnvServer {
+  std::string name;
+  int fd = -1; // Kept open for the lock
+  void *memory = nullptr;
+  size_t size = 0;
+  EnvRingHeader *header = nullptr;
+  chip8_env *env = nullptr;
+
+public:
+  uint64_t steps = 0;
+
+  ~EnvServer();
+
+  // Creates the segment /chip8-env-<name> with a chip8_env behind it
+  bool Start(const std::string &name, const uint8_t *rom, size_t romSize,
+             const chip8_env_options &options);
+
+  void Serve(); // Until a client sends EnvCommand::Stop
+
+  // /chip8-env-<name>, for removing it from a signal handler
+  std::string Segment() const;
+};
+
+class EnvClient {
+  int fd = -1;
+  void *memory = nullptr;
+  size_t size = 0;
+  EnvRingHeader *header = nullptr;
+  bool lost = false;
+
+  bool waitWhile(std::atomic<uint32_t> &word, uint32_t value);
+
+public:
+  ~EnvClient();
+
+  bool Connect(const std::string &name);
+  int Instances() const { return header->instances; }
+  int ObsFormat() const { return header->obsFormat; }
+  int ObsDepth() const { return header->obsDepth; }
+  size_t ObsSize() const { return header->obsSize; }
+  uint64_t StepNanos() const { return header->stepNanos; }
+
+  // The server went away while we waited for it. Next and Wait then return
+  // a slot of null pointers and Submit sends nothing
+  bool Lost() const { return lost; }
+
+  // Slot of the next request. Waits for one to free up when ENV_SERVER_SLOTS
+  // are in flight. Fill in the actions, then Submit
+  EnvSlot Next();
+  uint32_t Submit(EnvCommand command = EnvCommand::Step);
+
+  // Waits for a request to complete. The slot stays valid until
+  // ENV_SERVER_SLOTS more requests are submitted
+  EnvSlot Wait(uint32_t ticket);
+};
+} // namespace chip8
@@ -0,0 +1,62 @@
+#include <bitset>
+#include <coroutine>
+#include <exception>
+
+#include "chip8.hpp"
+
+namespace chip8 {
+#pragma once
+// Why an execution handed control back to its driver
+enum class Suspend {
+  Frame,      // The cycle budget ran out
+  KeyWait,    // Parked on FX0A, nothing to do until the keypad changes
+  Breakpoint, // About to execute an instruction at a breakpoint
+};
+
+// Owned by the driver, read by the execution on every cycle
+struct ExecutionControl {
+  int budget = 0; // Cycles left until the next Frame suspension
+  std::bitset<4096> breakpoints;
+};
+
+// A machine running as a coroutine. The driver tops up the budget and
+// resumes it, and gets back the reason it stopped. There is no per-session
+// state machine to keep around, so one thread can juggle as many sessions as
+// it likes
+class Execution {
+public:
+  struct promise_type {
+    Suspend reason = Suspend::Frame;
+
+    Execution get_return_object() {
+      return Execution(
+          std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    std::suspend_always final_suspend() noexcept { return {}; }
+    std::suspend_always yield_value(Suspend r) noexcept {
+      reason = r;
+      return {};
+    }
+
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+  };
+
+  Execution() = default;
+  Execution(Execution &&other) noexcept;
+  Execution &operator=(Execution &&other) noexcept;
+  ~Execution();
+
+  Suspend Resume();
+
+private:
+  explicit Execution(std::coroutine_handle<promise_type> h) : handle(h) {}
+
+  std::coroutine_handle<promise_type> handle;
+};
+
+// Starts suspended, the first Resume runs the first cycles
+Execution Execute(Chip8 *c8, ExecutionControl *control);
+} // namespace chip8
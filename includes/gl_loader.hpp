@@ -0,0 +1,76 @@
+#include <GLFW/glfw3.h>
+
+// Enums past OpenGL 1.1, which is all gl.h promises on Windows
+#ifndef GL_FRAGMENT_SHADER
+#define GL_FRAGMENT_SHADER 0x8B30
+#define GL_VERTEX_SHADER 0x8B31
+#define GL_COMPILE_STATUS 0x8B81
+#define GL_LINK_STATUS 0x8B82
+#define GL_CURRENT_PROGRAM 0x8B8D
+#endif
+
+#ifndef GL_FRAMEBUFFER
+#define GL_FRAMEBUFFER 0x8D40
+#define GL_FRAMEBUFFER_BINDING 0x8CA6
+#define GL_FRAMEBUFFER_COMPLETE 0x8CD5
+#define GL_COLOR_ATTACHMENT0 0x8CE0
+#endif
+
+#ifndef GL_R8UI
+#define GL_R8UI 0x8232
+#define GL_RED_INTEGER 0x8D94
+#endif
+
+#ifndef GL_VERTEX_ARRAY_BINDING
+#define GL_VERTEX_ARRAY_BINDING 0x85B5
+#endif
+
+#ifndef GL_TEXTURE0
+#define GL_TEXTURE0 0x84C0
+#define GL_ACTIVE_TEXTURE 0x84E0
+#endif
+
+#ifndef GL_RGB8
+#define GL_RGB8 0x8051
+#endif
+
+namespace chip8 {
+#pragma once
+// The post-1.1 entry points the display shaders use, looked up through GLFW
+// once there is a context. ImGui's backend loads its own set
+struct GLFunctions {
+  GLuint(APIENTRY *CreateShader)(GLenum type);
+  void(APIENTRY *ShaderSource)(GLuint shader, GLsizei count,
+                               const char *const *strings,
+                               const GLint *lengths);
+  void(APIENTRY *CompileShader)(GLuint shader);
+  void(APIENTRY *GetShaderiv)(GLuint shader, GLenum name, GLint *value);
+  void(APIENTRY *GetShaderInfoLog)(GLuint shader, GLsizei size,
+                                   GLsizei *length, char *log);
+  void(APIENTRY *DeleteShader)(GLuint shader);
+  GLuint(APIENTRY *CreateProgram)();
+  void(APIENTRY *AttachShader)(GLuint program, GLuint shader);
+  void(APIENTRY *LinkProgram)(GLuint program);
+  void(APIENTRY *GetProgramiv)(GLuint program, GLenum name, GLint *value);
+  void(APIENTRY *GetProgramInfoLog)(GLuint program, GLsizei size,
+                                    GLsizei *length, char *log);
+  void(APIENTRY *UseProgram)(GLuint program);
+  GLint(APIENTRY *GetUniformLocation)(GLuint program, const char *name);
+  void(APIENTRY *Uniform1i)(GLint location, GLint v0);
+  void(APIENTRY *Uniform1f)(GLint location, GLfloat v0);
+  void(APIENTRY *Uniform2f)(GLint location, GLfloat v0, GLfloat v1);
+  void(APIENTRY *Uniform3f)(GLint location, GLfloat v0, GLfloat v1,
+                            GLfloat v2);
+  void(APIENTRY *GenFramebuffers)(GLsizei n, GLuint *framebuffers);
+  void(APIENTRY *BindFramebuffer)(GLenum target, GLuint framebuffer);
+  void(APIENTRY *FramebufferTexture2D)(GLenum target, GLenum attachment,
+                                       GLenum textarget, GLuint texture,
+                                       GLint level);
+  GLenum(APIENTRY *CheckFramebufferStatus)(GLenum target);
+  void(APIENTRY *GenVertexArrays)(GLsizei n, GLuint *arrays);
+  void(APIENTRY *BindVertexArray)(GLuint array);
+  void(APIENTRY *ActiveTexture)(GLenum texture);
+
+  bool Load(); // False if the driver lacks any of them
+};
+} // namespace chip8
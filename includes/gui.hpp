@@ -5,12 +5,30 @@
 #include <imgui_memory_editor/imgui_memory_editor.h>
 
 #include "chip8.hpp"
+#include "display_renderer.hpp"
+#include "execution.hpp"
+#include "latency.hpp"
+#include "netplay.hpp"
+#include "palette.hpp"
+#include "phosphor.hpp"
+#include "recorder.hpp"
 
 #define DISPLAY_SCALE 12
 
-using high_resolution_time_point = std::chrono::time_point<
-    std::chrono::steady_clock,
-    std::chrono::duration<long long, std::ratio<1, 1000000000>>>;
+// The delay and sound timers count down at 60Hz
+#define TIMER_PERIOD std::chrono::nanoseconds(16666666)
+
+// Longest frame the clock catches up on. Anything longer (the window was
+// parked or dragged) is dropped instead of being replayed in one burst
+#define MAX_FRAME_TIME (1.0f / 20.0f)
+
+// Most frames the run-ahead mode may emulate into the future
+#define MAX_RUN_AHEAD 4
+
+// Frame time while the window is unfocused or minimized
+#define BACKGROUND_FRAME_TIME (1.0 / 20.0)
+
+using high_resolution_time_point = std::chrono::steady_clock::time_point;
 
 namespace chip8 {
 #pragma once
@@ -36,20 +54,73 @@ class GUI {
 
   int ticks = 0;
   bool tickRequested = false;
+  float cycleBudget = 0; // Fractional cycles carried over between frames
+  uint16_t breakpoint = 0x200;
+  bool displayFocused = false;
 
   int clockSpeed = 960;
   int prevClockSpeed = clockSpeed;
   Chip8 *interp;
 
+  // The interpreter runs as a coroutine, resumed once per update
+  ExecutionControl control;
+  Execution execution;
+
+  // Run-ahead: show the frame `runAhead` frames in the future, computed with
+  // the current input, then roll back. Hides the input lag that ROMs build in
+  // through their polling loops
+  int runAhead = 0;
+  Chip8 snapshot;
+  std::array<bool, 64 * 32> aheadDisplay;
+  bool aheadRedraw = false;
+
+  Netplay *netplay; // Drives the interpreter instead of the clock if set
+  uint16_t localKeys = 0; // Our keys for netplay as of the last reading
+
+  LatencyProbe latency;
+
   high_resolution_time_point lastTimer;
+  high_resolution_time_point lastUpdate;
 
   GLuint displayTexture;
   GLubyte *displayPixels;
+  Palette palette; // fgColor and bgColor as of the last upload
+  DisplayRenderer *renderer; // Colors on the GPU if set, else palette does
 
-  inline void Tick();
+  // Afterglow filter against sprite flicker, off by default
+  Phosphor phosphor;
+  bool phosphorOn = false;
+  bool phosphorShown = false; // phosphorOn as of the last upload
+  int phosphorDecay = PHOSPHOR_DECAY;
+  bool fading = false; // Keep redrawing, pixels are still fading out
 
-  inline void RenderDisplay(float);
+  // Records the display as RenderDisplay packs it, one frame per 60Hz tick.
+  // Plain bits in the current colors, without the afterglow
+  Recorder recorder;
+  bool recording = false;
+  bool recordFailed = false;
+  char recordFile[256] = "chip8.y4m";
+  PackedFrame recordFrame = {}; // The frame on screen
+  high_resolution_time_point lastCapture;
+
+  // What the panels showed in the last frame built, see Changed. Memory is
+  // tracked through the interpreter's dirtyPages instead
+  uint64_t shown = 0;
+  inline uint64_t signature();
+
+  inline bool KeyDown(int key);
+  inline uint16_t LocalKeys();
+  inline void ReadKeys();
+
+  inline bool TickTimers();
+  inline void RunAhead();
+
+  inline void RenderDisplay();
+  inline void Record();
   inline void RenderGeneral(float);
+  inline void RenderRecorder();
+  inline void RenderLatency(const char *, const LatencyHistogram &,
+                            const char *);
   inline void RenderCPUState();
   inline void RenderDebug();
   inline void RenderMemory();
@@ -57,7 +128,28 @@ class GUI {
   inline void RenderStack();
 
 public:
-  GUI(Chip8 *, GLuint, GLubyte *);
+  GUI(Chip8 *, GLuint, GLubyte *, Netplay * = nullptr,
+      DisplayRenderer * = nullptr);
+  // Kiosk mode: keys come straight from this window and Present draws the
+  // display over all of it, no ImGui involved. Needs the DisplayRenderer
+  GLFWwindow *kiosk = nullptr;
+
+  // Runs the interpreter, returns true if its state changed. ImGui only has
+  // the keyboard inside a frame, outside one pass false and the keypad stays
+  // as the last update left it
+  bool Update(bool input = true);
   void Render();
+  void Present(int width, int height); // Framebuffer size of the window
+
+  // Whether a frame built now would look any different from the last one.
+  // Counters that move on every instruction (ticks, FPS) don't count. In
+  // kiosk mode only the display does
+  bool Changed();
+
+  bool Idle(); // Paused or parked on FX0A
+
+  // Seconds the frontend may block waiting for events before the next update
+  // is due, 0 if it must keep polling. Background windows update less often
+  double IdleTimeout(bool background);
 };
 } // namespace chip8
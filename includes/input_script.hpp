@@ -0,0 +1,36 @@
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "chip8.hpp"
+
+namespace chip8 {
+#pragma once
+// Scripted keypad input for runs without a keyboard. One event per line:
+//
+//   # frame key state
+//   0 5 down
+//   30 5 up
+//
+// Keys are hex digits, states are down/up or 1/0. A script is immutable
+// once loaded, so one copy can drive any number of machines, each keeping
+// its own cursor
+class InputScript {
+  struct Event {
+    uint64_t frame;
+    uint8_t key;
+    bool down;
+  };
+
+  std::vector<Event> events; // Sorted by frame
+
+public:
+  bool Load(const std::string &filename);
+
+  // Applies every event up to and including frame, starting at cursor.
+  // Returns the new cursor
+  size_t Apply(Chip8 &c8, uint64_t frame, size_t cursor) const;
+
+  bool Exhausted(size_t cursor) const { return cursor >= events.size(); }
+};
+} // namespace chip8
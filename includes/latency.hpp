@@ -0,0 +1,56 @@
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+#define LATENCY_BUCKETS 32
+
+namespace chip8 {
+#pragma once
+// Log2 histogram. Bucket 0 counts zeros, bucket b counts [2^(b-1), 2^b)
+struct LatencyHistogram {
+  std::array<uint64_t, LATENCY_BUCKETS> buckets = {};
+  uint64_t count = 0;
+  uint64_t sum = 0;
+  uint64_t max = 0;
+
+  void Add(uint64_t value);
+  double Mean() const;
+
+  // The metric's rows of LatencyProbe::WriteCSV, without the header
+  void WriteCSV(std::ostream &out, const char *metric) const;
+};
+
+// Measures how long a key event takes to be (a) observed by EX9E, EXA1 or
+// FX0A and (b) followed by a framebuffer change from DXYN or 00E0, both in
+// cycles and in wall clock microseconds. Attach it with Chip8::probe
+class LatencyProbe {
+  struct Pending {
+    bool active = false;
+    bool observed = false;
+    uint64_t cycle = 0;
+    std::chrono::steady_clock::time_point time;
+  };
+
+  std::array<Pending, 16> pending; // Latest unresolved event for each key
+  int awaitingDisplay = 0;         // Observed events waiting for a redraw
+
+public:
+  LatencyHistogram observeCycles;
+  LatencyHistogram observeMicros;
+  LatencyHistogram displayCycles;
+  LatencyHistogram displayMicros;
+
+  void KeyEvent(uint8_t key, uint64_t cycle);
+  void KeyObserved(uint8_t key, uint64_t cycle);
+  void DisplayChanged(uint64_t cycle);
+
+  // The machine went back to `cycle` (a netplay rollback). Events after it
+  // are dropped, they never happened as far as the machine knows
+  void Rewind(uint64_t cycle);
+  void Reset();
+
+  // metric,bucket_low,bucket_high,count rows followed by a summary per metric
+  void WriteCSV(std::ostream &out) const;
+};
+} // namespace chip8
@@ -0,0 +1,43 @@
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "chip8.hpp"
+#include "input_script.hpp"
+#include "observation.hpp"
+#include "thread_pool.hpp"
+
+#define MOSAIC_CHUNK 16 // Instances per pool task
+
+namespace chip8 {
+#pragma once
+// Many copies of one ROM, each with its own CXNN seed, for watching a batch
+// at a glance. Every frame runs on the pool and leaves all the displays
+// packed back to back, ready to go up as one atlas in a single upload
+class Mosaic {
+  ThreadPool pool;
+  int cyclesPerFrame;
+
+  InputScript script;
+  std::vector<Chip8> machines;
+  std::vector<size_t> cursors;  // Per instance, into script
+  std::vector<uint64_t> frames; // PackedFrame per instance
+  uint64_t frame = 0;
+
+public:
+  explicit Mosaic(int threads = 0, int cyclesPerFrame = 960 / 60);
+
+  // Instance i runs with seed firstSeed + i. False if the ROM or input
+  // script could not be loaded
+  bool Load(const std::string &rom, int instances, uint32_t firstSeed,
+            const std::string &input = "");
+
+  bool RunFrame(); // Returns true if any display changed
+
+  int Instances() const { return (int)machines.size(); }
+  const Chip8 &Instance(int i) const { return machines[i]; }
+
+  // Instances() packed frames, instance i at Frames() + i * 32
+  const uint64_t *Frames() const { return frames.data(); }
+};
+} // namespace chip8
@@ -0,0 +1,58 @@
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "chip8.hpp"
+
+#define NETPLAY_MAX_ROLLBACK 8 // Frames we may run ahead of the remote player
+#define NETPLAY_RING 32        // Frames of input and snapshots kept around
+
+namespace chip8 {
+#pragma once
+// Two processes sharing one emulated machine over UDP. Both sides run the
+// same ROM from the same seed, each one owns some of the keypad and the
+// keypad the machine sees is the OR of both players' keys.
+//
+// Frames run immediately with the remote input predicted (its last known
+// state). When the real input arrives and differs from the prediction, the
+// machine is restored to the snapshot of that frame and replayed up to the
+// present.
+class Netplay {
+  Chip8 *interp;
+  int cyclesPerFrame;
+  intptr_t sock = -1;
+
+  uint32_t frame = 0;       // Next frame to emulate
+  uint32_t remoteFrames = 0; // Remote input is known for [0, remoteFrames)
+  uint32_t remoteAck = 0;    // The remote has our input for [0, remoteAck)
+
+  std::array<uint16_t, NETPLAY_RING> localInput;
+  std::array<uint16_t, NETPLAY_RING> remoteInput; // Confirmed or predicted
+  std::vector<Chip8> snapshots; // State at the start of each frame
+
+  void simulate(uint32_t f);
+  void send();
+  uint32_t receive();
+
+public:
+  uint32_t rollbacks = 0;           // Number of rollbacks so far
+  int lastRollbackFrames = 0;       // Frames replayed by the last rollback
+  double lastRollbackMicros = 0;    // Time the last rollback took
+  double maxRollbackMicros = 0;     // Worst rollback so far
+  uint32_t stalls = 0;              // Frames spent waiting on the remote
+
+  Netplay(Chip8 *c8, int cyclesPerFrame);
+  ~Netplay();
+
+  // Binds localPort and talks to host:port only. Both sides call it with
+  // their ports swapped, e.g. 127.0.0.1 7001 -> 7002 and 7002 -> 7001
+  bool Connect(uint16_t localPort, const std::string &host, uint16_t port);
+
+  // Runs the next frame with our keys (bit i = key i). Returns false without
+  // running it if we are too far ahead of the remote player
+  bool AdvanceFrame(uint16_t localKeys);
+
+  uint32_t Frame() const { return frame; }
+};
+} // namespace chip8
@@ -0,0 +1,63 @@
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "chip8.hpp"
+
+#define OBSERVATION_WIDTH 64
+#define OBSERVATION_HEIGHT 32
+#define OBSERVATION_SIZE (OBSERVATION_WIDTH * OBSERVATION_HEIGHT)
+
+namespace chip8 {
+#pragma once
+// Kernels turning the display into tensors for learning code. Frames are
+// kept packed, one 64 bit word per row with pixel x in bit x, which is 256
+// bytes a frame and cheap to stack, pool and downsample. Planes are only
+// expanded to bytes or floats at the very end, straight into the caller's
+// buffer. AVX2 when the CPU has it, plain loops otherwise (cpu.hpp).
+typedef uint64_t PackedFrame[OBSERVATION_HEIGHT];
+
+void PackDisplay(const Chip8 &c8, PackedFrame out);
+void PackDisplay(const std::array<bool, OBSERVATION_SIZE> &display,
+                 PackedFrame out);
+
+// out[i] = on or 0, OBSERVATION_SIZE bytes
+void ExpandU8(const PackedFrame frame, uint8_t *out, uint8_t on = 255);
+
+// out[i] = 1.0f or 0.0f, OBSERVATION_SIZE floats
+void ExpandFloat(const PackedFrame frame, float *out);
+
+// 32x16, a pixel is lit if any of its 2x2 block is. out[y] bit x
+void Downsample2x(const PackedFrame frame,
+                  uint32_t out[OBSERVATION_HEIGHT / 2]);
+
+// The last `depth` frames. Pushing writes one packed frame into the ring,
+// the planes are laid out only when expanding.
+//
+// CHIP-8 games draw by XORing sprites, so objects vanish for a frame while
+// they move. With maxPool every stacked frame is the max (OR) of a display
+// frame and the one before it, which hides the flicker
+class FrameStack {
+  int depth;
+  bool maxPool;
+  int pushed = 0;
+  std::vector<uint64_t> ring; // depth frames
+  PackedFrame previous = {};  // Last display frame, for pooling
+
+public:
+  FrameStack(int depth, bool maxPool = false);
+
+  int Depth() const { return depth; }
+
+  void Clear();
+  void Push(const PackedFrame frame);
+  void Push(const Chip8 &c8);
+
+  // age 0 is the newest frame. Frames not pushed yet are blank
+  const uint64_t *Frame(int age) const;
+
+  // depth planes, oldest first
+  void ExpandU8(uint8_t *out, uint8_t on = 255) const;
+  void ExpandFloat(float *out) const;
+};
+} // namespace chip8
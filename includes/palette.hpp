@@ -0,0 +1,41 @@
+#include <cstdint>
+
+#include "observation.hpp"
+
+#define PALETTE_RGB_SIZE (OBSERVATION_SIZE * 3)
+
+namespace chip8 {
+#pragma once
+// Turns packed frames into 64x32 RGB for textures, frame dumps and video.
+// Lit pixels get fg, the rest bg. Both colors are baked into tables once, so
+// a conversion is table lookups and blends: 32 pixels (96 bytes) per round
+// on CPUs with AVX2, 8 pixels per lookup otherwise
+class Palette {
+  uint8_t fg[3];
+  uint8_t bg[3];
+
+  // 32 pixels worth of each color, for blending
+  alignas(32) uint8_t fgPattern[96];
+  alignas(32) uint8_t bgPattern[96];
+
+  uint8_t lut[256][24]; // RGB of 8 pixels for every byte of the frame
+  uint8_t ramp[256][4]; // bg to fg by intensity, padded for 4 byte copies
+
+public:
+  Palette(); // The frontend's default green on black
+  Palette(const uint8_t fg[3], const uint8_t bg[3]);
+
+  void Set(const uint8_t fg[3], const uint8_t bg[3]);
+  bool Matches(const uint8_t fg[3], const uint8_t bg[3]) const;
+
+  // PALETTE_RGB_SIZE bytes, row major
+  void ToRGB(const PackedFrame frame, uint8_t *out) const;
+
+  // Any packed image (Scale2x and friends), count words of 64 pixels in
+  // order. count * 64 * 3 bytes
+  void ToRGB(const uint64_t *words, int count, uint8_t *out) const;
+
+  // Same from OBSERVATION_SIZE intensities (Phosphor), 0 is bg, 255 is fg
+  void ToRGB(const uint8_t *intensity, uint8_t *out) const;
+};
+} // namespace chip8
@@ -0,0 +1,36 @@
+#include <cstdint>
+
+#include "latency.hpp"
+#include "observation.hpp"
+
+#define PHOSPHOR_DECAY 176 // Default brightness kept per frame, out of 256
+
+namespace chip8 {
+#pragma once
+// Fakes the afterglow of a CRT. Games erase sprites by XORing them away and
+// draw them again a moment later, and every frame that catches a sprite
+// erased shows it missing. Here lit pixels are at full brightness and unlit
+// ones fade out over a few frames, which hides that flicker.
+//
+// Brightness is a byte per pixel. Apply lights up the frame's pixels and
+// scales the rest by decay / 256, 32 pixels per instruction on CPUs with AVX2
+class Phosphor {
+  alignas(32) uint8_t intensity[OBSERVATION_SIZE] = {};
+  uint8_t decay;
+
+public:
+  LatencyHistogram applyNanos; // Wall time of every Apply
+
+  explicit Phosphor(uint8_t decay = PHOSPHOR_DECAY);
+
+  void SetDecay(uint8_t decay) { this->decay = decay; }
+  void Clear();
+
+  // Runs once per 60Hz frame. Returns true while some pixel is still fading,
+  // the output keeps changing until then even if the frames don't
+  bool Apply(const PackedFrame frame);
+
+  // OBSERVATION_SIZE bytes, row major, 255 is lit
+  const uint8_t *Intensity() const { return intensity; }
+};
+} // namespace chip8
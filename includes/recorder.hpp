@@ -0,0 +1,105 @@
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "chip8.hpp"
+#include "observation.hpp"
+#include "palette.hpp"
+
+#define RECORDER_CAPACITY 256 // Frames queued between emulation and encoder
+
+namespace chip8 {
+#pragma once
+enum class VideoFormat {
+  Raw, // RGB24 frames back to back, no header
+  Y4M, // YUV4MPEG2, 4:4:4 so single pixels keep their color
+  GIF, // One shared two color palette, only changed rows per frame
+};
+
+// What Capture does when the encoder is a whole queue behind
+enum class Backpressure {
+  Drop,  // Drop the frame, counted in dropped. For interactive use
+  Block, // Wait for a free slot, counted in blocked. For offline runs
+};
+
+struct RecorderOptions {
+  VideoFormat format = VideoFormat::Y4M;
+  Backpressure backpressure = Backpressure::Drop;
+  int scale = 1;          // Nearest neighbour
+  int capacity = RECORDER_CAPACITY;
+  uint8_t fg[3] = {0x00, 0xFF, 0x9B}; // The frontend's default colors
+  uint8_t bg[3] = {0x0B, 0x0B, 0x0B};
+};
+
+// Records every 60Hz frame to a file without slowing emulation down. Capture
+// packs the display (256 bytes) into a single producer, single consumer ring
+// and returns, an encoder thread takes frames off the other end and does the
+// color conversion, scaling and compression.
+//
+// Only one thread may call Capture
+class Recorder {
+  struct Slot {
+    PackedFrame frame;
+  };
+
+  RecorderOptions options;
+  std::ofstream file;
+  std::thread encoder;
+
+  std::vector<Slot> ring;
+  std::atomic<uint64_t> head{0};   // Next slot to fill, written by Capture
+  std::atomic<uint64_t> tail{0};   // Next slot to encode, written by encoder
+  std::atomic<uint32_t> signal{0}; // Bumped on every push and on Close
+  std::atomic<bool> closing{false};
+
+  int width = 0;
+  int height = 0;
+
+  // Encoder state, only touched by the encoder thread after Open
+  Palette palette;
+  std::vector<uint8_t> rgb;
+  std::vector<uint8_t> pixels; // Scaled RGB, a Y4M plane or GIF indices
+  uint8_t fgYUV[3], bgYUV[3];
+  uint64_t encoded = 0; // Frames taken off the ring
+
+  // GIF frames are written once the next different one shows up, so their
+  // delay is known. Identical frames only make the delay longer
+  PackedFrame shown = {};    // What a decoder shows after the last write
+  PackedFrame pending = {};  // Frame waiting to be written
+  uint64_t pendingSince = 0; // Frame number it showed up at
+  bool hasPending = false;
+  std::vector<uint16_t> lzw; // Code table, 4 children per code
+
+  void run();
+  void encode(const PackedFrame frame);
+  void writeY4M(const PackedFrame frame);
+  void writeGIFHeader();
+  void writeGIFFrame(const PackedFrame frame, int delay);
+  void writeLZW(const uint8_t *indices, size_t count);
+  void finish();
+
+public:
+  std::atomic<uint64_t> captured{0}; // Frames handed to Capture
+  std::atomic<uint64_t> dropped{0};  // Not recorded, the queue was full
+  std::atomic<uint64_t> blocked{0};  // Recorded, but Capture had to wait
+
+  Recorder() = default;
+  ~Recorder();
+
+  // Starts the encoder thread. False if the file can't be written
+  bool Open(const std::string &filename, const RecorderOptions &options);
+
+  // Queues c8's display as the next frame
+  void Capture(const Chip8 &c8);
+  void Capture(const PackedFrame frame);
+
+  // Encodes everything queued, finishes the file and stops the thread
+  void Close();
+};
+
+// Y4M for .y4m, GIF for .gif, Raw for anything else
+VideoFormat VideoFormatFromName(const std::string &filename);
+} // namespace chip8
@@ -0,0 +1,63 @@
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "chip8.hpp"
+#include "thread_pool.hpp"
+
+#define SWEEP_CHUNK 64 // Seeds per pool task
+
+namespace chip8 {
+#pragma once
+struct SweepOptions {
+  std::string rom;
+  std::string input;      // Input script, empty for none
+  uint32_t firstSeed = 1; // Seeds firstSeed, firstSeed + 1, ...
+  uint32_t seeds = 1000;
+  uint64_t frames = 3600; // Frame limit of every run
+  int untilPc = -1;       // Stop a run once PC gets here, -1 for never
+};
+
+struct SweepRun {
+  uint32_t seed = 0;
+  bool hit = false;    // Reached untilPc before the frame limit
+  uint64_t frames = 0; // Frames run
+  uint64_t cycles = 0; // Instructions executed
+  uint16_t pc = 0;
+  uint32_t displayHash = 0;
+};
+
+struct SweepOutcome {
+  uint32_t displayHash;
+  uint16_t pc;
+  uint32_t runs;
+};
+
+struct SweepSummary {
+  uint64_t sharedFrames = 0; // Run once for all seeds, before the first CXNN
+  uint64_t sharedCycles = 0;
+  uint32_t hits = 0;
+
+  // Frames per run
+  uint64_t minFrames = 0, medianFrames = 0, p90Frames = 0, maxFrames = 0;
+  double meanFrames = 0;
+
+  std::vector<SweepOutcome> outcomes; // Distinct end states, most common first
+};
+
+// Runs one ROM across many CXNN seeds. Nothing depends on the seed until the
+// first CXNN, so everything up to it runs once and every seed forks from that
+// state. Seeds then run on the pool in chunks
+class SeedSweep {
+  ThreadPool pool;
+  int cyclesPerFrame;
+
+public:
+  explicit SeedSweep(int threads = 0, int cyclesPerFrame = 960 / 60,
+                     bool pin = false);
+
+  // False if the ROM or input script could not be loaded
+  bool Run(const SweepOptions &options, std::vector<SweepRun> &runs,
+           SweepSummary &summary);
+};
+} // namespace chip8
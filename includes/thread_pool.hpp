@@ -0,0 +1,56 @@
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace chip8 {
+#pragma once
+// Fixed set of workers, each with its own deque. A worker takes its newest
+// task first and, once it runs dry, steals the oldest task of another worker.
+// Tasks that finish at very different times then even out on their own
+class ThreadPool {
+public:
+  using Task = std::function<void(int worker)>;
+
+private:
+  struct Worker {
+    std::mutex lock;
+    std::deque<Task> tasks;
+  };
+
+  std::vector<std::unique_ptr<Worker>> workers;
+  std::vector<std::thread> threads;
+
+  std::mutex sleepLock;
+  std::condition_variable wake; // Tasks were queued or the pool is stopping
+  std::condition_variable idle; // The last pending task finished
+  std::atomic<long> queued{0};    // Submitted, not yet taken by a worker
+  std::atomic<size_t> pending{0}; // Submitted, not yet finished
+  std::atomic<size_t> next{0};    // Round robin for outside submissions
+  bool stopping = false;
+
+  std::vector<int> cpus; // Worker i runs on cpus[i % size], empty if unpinned
+
+  bool pop(int self, Task &task);
+  void run(int self);
+  void stop();
+
+public:
+  // threads = 0 for one per CPU we may run on. With pin every worker stays
+  // on one CPU (Linux only), filling NUMA nodes one after another, so its
+  // memory stays on that CPU's node. Throws std::system_error when the
+  // workers can't be started
+  explicit ThreadPool(int threads = 0, bool pin = false);
+  ~ThreadPool();
+
+  int Size() const { return (int)workers.size(); }
+
+  void Submit(Task task);             // Spread over the workers
+  void Submit(int worker, Task task); // Onto a worker's own deque
+  void Wait();                        // Until every task has finished
+};
+} // namespace chip8
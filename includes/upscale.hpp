@@ -0,0 +1,26 @@
+#include <cstdint>
+
+#include "observation.hpp"
+
+namespace chip8 {
+#pragma once
+// Pixel art upscaling on the CPU, for output that doesn't go through a GPU
+// (frame dumps, video, screenshots).
+//
+// Scale2x and Scale3x (EPX) work on packed bits: `words` 64 bit words per
+// row, pixel x in bit x % 64 of word x / 64, like PackedFrame. Their rules
+// are all comparisons between neighbours, which on bits are XORs, so every
+// operation handles 64 pixels at once and nothing is expanded to bytes until
+// the palette does it at the very end. Edges repeat the border pixels.
+
+// out: 2 * words per row, 2 * height rows
+void Scale2x(const uint64_t *in, int words, int height, uint64_t *out);
+
+// out: 3 * words per row, 3 * height rows
+void Scale3x(const uint64_t *in, int words, int height, uint64_t *out);
+
+// Nearest neighbour by a whole factor, on RGB (or anything with 3 bytes per
+// pixel). out is width * factor by height * factor
+void ScaleNearest(const uint8_t *rgb, int width, int height, int factor,
+                  uint8_t *out);
+} // namespace chip8
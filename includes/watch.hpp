@@ -0,0 +1,93 @@
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "chip8.hpp"
+
+namespace chip8 {
+#pragma once
+// Reward and termination signals written as predicates over the machine:
+//
+//   mem[0x2F0] changed
+//   v3 > 10
+//   bcd[i] decreased
+//   bcd[0x300] >= 500
+//
+// Sources are vX, mem[addr] and bcd[addr] (three BCD digits as written by
+// FX33, at a fixed address). bcd[i] reads them wherever the last FX33 put
+// them, I itself has usually moved on by then (FX33 then F265). Conditions
+// are changed, increased and decreased, or a comparison (== != < <= > >=)
+// with a number. Comparisons fire when they become true, not while they stay
+// true.
+//
+// Memory is only written by FX33 and FX55, which flag the watched 64 byte
+// pages in Chip8::dirtyPages. Memory predicates are looked at only when one
+// of their pages was written, so Evaluate is a couple of compares when
+// nothing happened. Register predicates are cheap enough to check each time
+enum class WatchSignal { Reward, Done };
+
+struct WatchResult {
+  float reward = 0;
+  bool done = false;
+};
+
+// What one machine's predicates saw at the last evaluation. A Watch is
+// compiled once and shared, every machine it looks at keeps one of these
+class WatchState {
+  friend class Watch;
+
+  struct Seen {
+    uint16_t address; // FX33 target, for bcd[i]
+    int last;         // Value at the last evaluation
+    bool held;        // Comparison was true at the last evaluation
+  };
+
+  std::vector<Seen> seen; // One per predicate
+};
+
+class Watch {
+  enum class Source : uint8_t { Register, Memory, Bcd, BcdAtIndex };
+  enum class Condition : uint8_t {
+    Changed,
+    Increased,
+    Decreased,
+    Equal,
+    NotEqual,
+    Less,
+    LessEqual,
+    Greater,
+    GreaterEqual,
+  };
+
+  struct Predicate {
+    Source source;
+    Condition condition;
+    WatchSignal signal;
+    uint16_t address; // Register number for Source::Register
+    int operand;
+    float reward;
+    uint64_t pages; // Pages the value lives in
+  };
+
+  std::vector<Predicate> predicates;
+  uint64_t pages = 0;     // Union over the memory predicates
+  bool registers = false; // Some predicate reads a register
+
+  static int value(const Predicate &p, const Chip8 &c8);
+  static bool compare(const Predicate &p, int value);
+
+public:
+  // Prints the reason and returns false when expression does not parse
+  bool Add(const std::string &expression, WatchSignal signal,
+           float reward = 1);
+
+  bool Empty() const { return predicates.empty(); }
+
+  // Starts watching c8, keeping track in state. Call again after the machine
+  // is reset or replaced. Only allocates when predicates were added since
+  void Attach(Chip8 &c8, WatchState &state) const;
+
+  // Signals fired since the last call (or Attach)
+  WatchResult Evaluate(Chip8 &c8, WatchState &state) const;
+};
+} // namespace chip8
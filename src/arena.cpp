@@ -0,0 +1,68 @@
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#include "arena.hpp"
+
+namespace chip8 {
+static void *allocateChunk(size_t size) {
+#ifdef __linux__
+  // Over-allocate by a huge page and trim, mmap alone only aligns to 4 KB
+  size_t mapped = size + ARENA_CHUNK;
+  void *p = mmap(nullptr, mapped, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED) {
+    throw std::bad_alloc();
+  }
+
+  uintptr_t start = (uintptr_t)p;
+  uintptr_t aligned = (start + ARENA_CHUNK - 1) & ~(uintptr_t)(ARENA_CHUNK - 1);
+  if (aligned > start) {
+    munmap(p, aligned - start);
+  }
+  if (aligned + size < start + mapped) {
+    munmap((void *)(aligned + size), start + mapped - aligned - size);
+  }
+
+  madvise((void *)aligned, size, MADV_HUGEPAGE);
+  return (void *)aligned;
+#else
+  return ::operator new(size, std::align_val_t(ARENA_CHUNK));
+#endif
+}
+
+static void freeChunk(void *p, size_t size) {
+#ifdef __linux__
+  munmap(p, size);
+#else
+  ::operator delete(p, std::align_val_t(ARENA_CHUNK));
+#endif
+}
+
+Arena::~Arena() {
+  for (auto &[p, size] : chunks) {
+    freeChunk(p, size);
+  }
+}
+
+void *Arena::Allocate(size_t size, size_t align) {
+  size_t padding = (align - (uintptr_t)cursor % align) % align;
+
+  if (cursor == nullptr || padding + size > left) {
+    size_t chunk = (size + ARENA_CHUNK - 1) / ARENA_CHUNK * ARENA_CHUNK;
+    cursor = (uint8_t *)allocateChunk(chunk);
+    left = chunk;
+    chunks.push_back({cursor, chunk});
+    padding = 0;
+  }
+
+  void *p = cursor + padding;
+  cursor += padding + size;
+  left -= padding + size;
+  return p;
+}
+} // namespace chip8
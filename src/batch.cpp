@@ -0,0 +1,188 @@
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+
+#include "batch.hpp"
+
+namespace chip8 {
+bool LoadBatchJobs(const std::string &filename, std::vector<BatchJob> &jobs) {
+  std::ifstream ifile(filename);
+
+  if (!ifile) {
+    return false;
+  }
+
+  std::string line;
+  int lineNumber = 0;
+  while (std::getline(ifile, line)) {
+    lineNumber++;
+
+    auto comment = line.find('#');
+    if (comment != std::string::npos) {
+      line.erase(comment);
+    }
+
+    std::istringstream fields(line);
+    BatchJob job;
+    if (!(fields >> job.rom)) {
+      continue; // Blank line
+    }
+
+    if (!(fields >> job.seed >> job.input >> job.cycles)) {
+      std::cerr << filename << ":" << lineNumber
+                << ": expected 'rom seed input cycles'" << std::endl;
+      return false;
+    }
+
+    if (job.input == "-") {
+      job.input.clear();
+    }
+
+    jobs.push_back(job);
+  }
+
+  return true;
+}
+
+uint32_t DisplayHash(const Chip8 &c8) {
+  uint32_t hash = 2166136261u;
+  for (bool pixel : c8.display) {
+    hash = (hash ^ pixel) * 16777619u;
+  }
+
+  return hash;
+}
+
+HaltReason Halted(const Chip8 &c8, bool inputDone) {
+  if (c8.waitingForKey && inputDone) {
+    return HaltReason::KeyWait;
+  }
+
+  // Spinning in place. The timers still count down and may beep, so only
+  // once they have run out
+  uint16_t opcode = c8.mem[c8.pc & 0xFFF] << 8 | c8.mem[(c8.pc + 1) & 0xFFF];
+  if (opcode == (0x1000 | c8.pc) && c8.delayTimer == 0 &&
+      c8.soundTimer == 0) {
+    return HaltReason::SelfJump;
+  }
+
+  return HaltReason::None;
+}
+
+const char *HaltReasonName(HaltReason reason) {
+  switch (reason) {
+  case HaltReason::SelfJump:
+    return "self_jump";
+  case HaltReason::KeyWait:
+    return "key_wait";
+  default:
+    return "";
+  }
+}
+
+Batch::Batch(int threads, int cyclesPerFrame, bool pin)
+    : pool(threads, pin), cyclesPerFrame(cyclesPerFrame),
+      arenas(pool.Size()), machines(pool.Size()) {}
+
+Chip8 *Batch::acquire(int worker) {
+  auto &free = machines[worker];
+  if (free.empty()) {
+    if (arenas[worker] == nullptr) {
+      arenas[worker] = std::make_unique<Arena>();
+    }
+
+    return arenas[worker]->New<Chip8>();
+  }
+
+  Chip8 *c8 = free.back();
+  free.pop_back();
+  return c8;
+}
+
+void Batch::release(int worker, Chip8 *c8) { machines[worker].push_back(c8); }
+
+void Batch::run(const BatchJob &job, BatchResult &result, int worker) {
+  auto start = std::chrono::steady_clock::now();
+
+  auto &rom = roms.at(job.rom);
+  auto *script = job.input.empty() ? nullptr : &scripts.at(job.input);
+
+  Chip8 *c8 = acquire(worker);
+  c8->Reset();
+  c8->Seed(job.seed);
+
+  // Too big for memory
+  if (!c8->LoadProgram(rom.data(), rom.size())) {
+    result.loaded = false;
+    release(worker, c8);
+    return;
+  }
+
+  size_t cursor = 0;
+  uint64_t frame = 0;
+  while (c8->cycles < job.cycles) {
+    if (script != nullptr) {
+      cursor = script->Apply(*c8, frame, cursor);
+    }
+
+    c8->RunFrame(std::min<uint64_t>(cyclesPerFrame, job.cycles - c8->cycles));
+    frame++;
+
+    bool inputDone = script == nullptr || script->Exhausted(cursor);
+    result.halt = Halted(*c8, inputDone);
+    if (result.halt != HaltReason::None) {
+      break;
+    }
+  }
+
+  result.cycles = c8->cycles;
+  result.frames = frame;
+  result.pc = c8->pc;
+  result.displayHash = DisplayHash(*c8);
+
+  release(worker, c8);
+
+  result.micros = std::chrono::duration<double, std::micro>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+}
+
+std::vector<BatchResult> Batch::Run(const std::vector<BatchJob> &jobs) {
+  std::vector<BatchResult> results(jobs.size());
+
+  // Read every ROM and script once, up front. The maps are not touched
+  // concurrently after this
+  std::map<std::string, bool> loaded;
+  for (auto &job : jobs) {
+    if (!loaded.count(job.rom)) {
+      std::ifstream ifile(job.rom, std::ios::binary);
+      roms[job.rom].assign(std::istreambuf_iterator<char>(ifile),
+                           std::istreambuf_iterator<char>());
+      loaded[job.rom] = ifile.good() || ifile.eof();
+    }
+
+    if (!job.input.empty() && !loaded.count(job.input)) {
+      loaded[job.input] = scripts[job.input].Load(job.input);
+    }
+  }
+
+  for (size_t i = 0; i < jobs.size(); i++) {
+    auto &job = jobs[i];
+    results[i].loaded =
+        loaded[job.rom] && (job.input.empty() || loaded[job.input]);
+
+    if (results[i].loaded) {
+      pool.Submit([this, &job, &result = results[i]](int worker) {
+        run(job, result, worker);
+      });
+    }
+  }
+
+  pool.Wait();
+  return results;
+}
+} // namespace chip8
@@ -0,0 +1,187 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#include "batch.hpp"
+#include "sweep.hpp"
+
+static void usage(const char *argv0) {
+  std::cerr << "Usage:" << std::endl
+            << argv0 << " [options] jobs.txt" << std::endl
+            << argv0 << " [options] --sweep rom" << std::endl
+            << std::endl
+            << "  --threads n  Worker threads (default: one per core)"
+            << std::endl
+            << "  --clock hz   Instructions per second (default 960)"
+            << std::endl
+            << "  --pin        Pin workers to CPUs (Linux)" << std::endl
+            << std::endl
+            << "Sweep options:" << std::endl
+            << "  --seeds n       Number of seeds (default 1000)" << std::endl
+            << "  --first-seed n  First seed (default 1)" << std::endl
+            << "  --frames n      Frame limit of every run (default 3600)"
+            << std::endl
+            << "  --input file    Input script" << std::endl
+            << "  --until-pc hex  Stop a run once PC gets here" << std::endl
+            << "  --runs          Print every run as CSV" << std::endl
+            << std::endl
+            << "Every line of jobs.txt is 'rom seed input cycles', with '-' "
+               "for no input script. Results are written to stdout as CSV."
+            << std::endl
+            << std::endl
+            << "--sweep runs one ROM across many CXNN seeds and prints "
+               "statistics over the runs."
+            << std::endl;
+}
+
+static int sweep(const chip8::SweepOptions &options, int threads,
+                 int clockSpeed, bool pin, bool printRuns) {
+  auto start = std::chrono::steady_clock::now();
+
+  chip8::SeedSweep sweep(threads, clockSpeed / 60, pin);
+  std::vector<chip8::SweepRun> runs;
+  chip8::SweepSummary summary;
+  if (!sweep.Run(options, runs, summary)) {
+    std::cerr << "Unable to load " << options.rom << std::endl;
+    return -1;
+  }
+
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+
+  if (printRuns) {
+    std::cout << "seed,hit,frames,cycles,pc,display_hash" << std::endl;
+    for (auto &run : runs) {
+      std::cout << run.seed << "," << run.hit << "," << run.frames << ","
+                << run.cycles << "," << run.pc << "," << run.displayHash
+                << std::endl;
+    }
+
+    std::cout << std::endl;
+  }
+
+  std::cout << "Runs:          " << runs.size() << std::endl
+            << "Shared prefix: " << summary.sharedFrames << " frames, "
+            << summary.sharedCycles << " cycles" << std::endl;
+
+  if (options.untilPc >= 0) {
+    std::cout << "Reached PC:    " << summary.hits << std::endl;
+  }
+
+  std::cout << "Frames:        min " << summary.minFrames << ", mean "
+            << summary.meanFrames << ", median " << summary.medianFrames
+            << ", p90 " << summary.p90Frames << ", max " << summary.maxFrames
+            << std::endl
+            << "End states:    " << summary.outcomes.size() << " distinct"
+            << std::endl;
+
+  for (size_t i = 0; i < summary.outcomes.size() && i < 10; i++) {
+    auto &outcome = summary.outcomes[i];
+    std::cout << "  " << std::setw(6) << outcome.runs << " runs  pc 0x"
+              << std::hex << outcome.pc << "  display " << outcome.displayHash
+              << std::dec << std::endl;
+  }
+
+  std::cerr << "Swept " << runs.size() << " seeds in " << seconds << "s"
+            << std::endl;
+  return 0;
+}
+
+int main(int args, char **argv) {
+  const char *jobsFile = NULL;
+  int threads = 0;
+  int clockSpeed = 960;
+
+  chip8::SweepOptions sweepOptions;
+  bool sweepMode = false;
+  bool printRuns = false;
+  bool pin = false;
+
+  for (int i = 1; i < args; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < args;
+
+    if (arg == "--threads" && hasValue) {
+      threads = atoi(argv[++i]);
+    } else if (arg == "--clock" && hasValue) {
+      clockSpeed = atoi(argv[++i]);
+    } else if (arg == "--sweep" && hasValue) {
+      sweepMode = true;
+      sweepOptions.rom = argv[++i];
+    } else if (arg == "--seeds" && hasValue) {
+      sweepOptions.seeds = strtoul(argv[++i], NULL, 10);
+    } else if (arg == "--first-seed" && hasValue) {
+      sweepOptions.firstSeed = strtoul(argv[++i], NULL, 10);
+    } else if (arg == "--frames" && hasValue) {
+      sweepOptions.frames = strtoull(argv[++i], NULL, 10);
+    } else if (arg == "--input" && hasValue) {
+      sweepOptions.input = argv[++i];
+    } else if (arg == "--until-pc" && hasValue) {
+      sweepOptions.untilPc = strtol(argv[++i], NULL, 16);
+    } else if (arg == "--pin") {
+      pin = true;
+    } else if (arg == "--runs") {
+      printRuns = true;
+    } else if (arg[0] == '-') {
+      usage(argv[0]);
+      return 1;
+    } else {
+      jobsFile = argv[i];
+    }
+  }
+
+  if (sweepMode) {
+    return sweep(sweepOptions, threads, clockSpeed, pin, printRuns);
+  }
+
+  if (jobsFile == NULL) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  std::vector<chip8::BatchJob> jobs;
+  if (!chip8::LoadBatchJobs(jobsFile, jobs)) {
+    std::cerr << "Unable to load " << jobsFile << std::endl;
+    return -1;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+
+  chip8::Batch batch(threads, clockSpeed / 60, pin);
+  auto results = batch.Run(jobs);
+
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+
+  std::cout << "job,rom,seed,cycles,frames,pc,display_hash,halt,micros"
+            << std::endl;
+  int failed = 0;
+  int halted = 0;
+  for (size_t i = 0; i < jobs.size(); i++) {
+    auto &job = jobs[i];
+    auto &result = results[i];
+
+    if (!result.loaded) {
+      std::cerr << "Job " << i << ": unable to load " << job.rom << std::endl;
+      failed++;
+      continue;
+    }
+
+    halted += result.halt != chip8::HaltReason::None;
+
+    std::cout << i << "," << job.rom << "," << job.seed << "," << result.cycles
+              << "," << result.frames << "," << result.pc << ","
+              << result.displayHash << "," << HaltReasonName(result.halt)
+              << "," << result.micros << std::endl;
+  }
+
+  std::cerr << "Ran " << jobs.size() - failed << " jobs in " << seconds << "s, "
+            << halted << " halted early" << std::endl;
+
+  return failed == 0 ? 0 : -1;
+}
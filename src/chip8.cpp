@@ -1,12 +1,18 @@
+#include <algorithm>
 #include <cstdint>
 #include <cstdlib>
 #include <fstream>
 #include <iostream>
 #include <string>
+#include <type_traits>
 
 #include "chip8.hpp"
+#include "latency.hpp"
 
 namespace chip8 {
+static_assert(std::is_trivially_copyable_v<Chip8>,
+              "Chip8 snapshots rely on it being a plain copyable value");
+
 void Chip8::Reset() {
   // Program Counter starts at 0x200
   pc = 0x200;
@@ -15,6 +21,10 @@ void Chip8::Reset() {
   index = 0;
   sp = 0;
   opcode = 0;
+  cycles = 0;
+  waitingForKey = false;
+  dirtyPages = 0;
+  bcdAddress = 0;
 
   // Reset timers
   delayTimer = 0;
@@ -24,6 +34,7 @@ void Chip8::Reset() {
   for (bool &i : display) {
     i = false;
   }
+  dirtyRows = 0xFFFFFFFF;
 
   // Clear registers
   for (unsigned char &i : reg) {
@@ -35,12 +46,29 @@ void Chip8::Reset() {
     i = 0;
   }
 
+  // Clear memory and keypad, so a reused machine starts from the same state
+  // as a new one
+  mem.fill(0);
+  keypadState.fill(false);
+
   // Load the font into memory
   for (int i = 0; i < 80; i++) {
     mem[i] = font[i];
   }
 }
 
+void Chip8::Seed(uint32_t seed) {
+  // xorshift gets stuck on a zero state
+  rngState = seed != 0 ? seed : 0x2545F491;
+}
+
+uint8_t Chip8::random() {
+  rngState ^= rngState << 13;
+  rngState ^= rngState >> 17;
+  rngState ^= rngState << 5;
+  return rngState >> 24;
+}
+
 bool Chip8::LoadProgram(const std::string &filename) {
   std::ifstream ifile;
 
@@ -54,6 +82,11 @@ bool Chip8::LoadProgram(const std::string &filename) {
   char b;
 
   while (ifile.get(b)) {
+    // Doesn't fit in memory
+    if (i + 512 >= (int)mem.size()) {
+      return false;
+    }
+
     mem[i + 512] = b;
     i++;
   }
@@ -63,6 +96,27 @@ bool Chip8::LoadProgram(const std::string &filename) {
   return true;
 }
 
+void Chip8::SetKey(uint8_t key, bool down) {
+  if (keypadState[key] == down) {
+    return;
+  }
+
+  keypadState[key] = down;
+
+  if (probe != nullptr && !speculative) {
+    probe->KeyEvent(key, cycles);
+  }
+}
+
+bool Chip8::LoadProgram(const uint8_t *program, size_t size) {
+  if (size > mem.size() - 512) {
+    return false;
+  }
+
+  std::copy(program, program + size, mem.begin() + 512);
+  return true;
+}
+
 void Chip8::stackPush(uint16_t data) {
   stack[sp] = data;
   sp++;
@@ -76,6 +130,10 @@ uint16_t Chip8::stackPop() {
 
 void Chip8::Tick() {
   opcode = mem[pc] << 8 | mem[pc + 1]; // Fetch a 16bit opcode
+  cycles++;
+
+  // Only report to the probe for frames that are not rolled back
+  LatencyProbe *probe = speculative ? nullptr : this->probe;
 
   bool invalid = false;
 
@@ -91,6 +149,11 @@ void Chip8::Tick() {
 
       pc += 2;
       redraw = true;
+      dirtyRows = 0xFFFFFFFF;
+
+      if (probe != nullptr) {
+        probe->DisplayChanged(cycles);
+      }
 
       break;
     }
@@ -287,23 +350,25 @@ void Chip8::Tick() {
 
   // CXNN (Set vX to rand & NN)
   case 0xC000: {
-    reg[(opcode & 0x0F00) >> 8] = (rand() % 0xFF) & (opcode & 0x00FF);
+    reg[(opcode & 0x0F00) >> 8] = (random() % 0xFF) & (opcode & 0x00FF);
     pc += 2;
     break;
   }
 
   // DXYN (Display X, Y, N)
   case 0xD000: {
-    auto x = reg[(opcode & 0x0F00) >> 8];
-    auto y = reg[(opcode & 0x00F0) >> 4];
+    // The sprite starts at (vX, vY) wrapped onto the screen, whatever runs
+    // past the right or bottom edge is clipped
+    int x = reg[(opcode & 0x0F00) >> 8] % 64;
+    int y = reg[(opcode & 0x00F0) >> 4] % 32;
     uint8_t height = opcode & 0x000F;
 
     // Clear the status (F) reg
     reg[0xF] = 0;
-    for (int yLine = 0; yLine < height; yLine++) {
-      auto pixel = mem[index + yLine];
+    for (int yLine = 0; yLine < height && y + yLine < 32; yLine++) {
+      auto pixel = mem[(index + yLine) & 0xFFF];
 
-      for (int xLine = 0; xLine < 8; xLine++) {
+      for (int xLine = 0; xLine < 8 && x + xLine < 64; xLine++) {
         if ((pixel & (0x80 >> xLine)) != 0) {
           if (display[(x + xLine + ((y + yLine) * 64))] == 1) {
             reg[0xF] = 1;
@@ -312,11 +377,17 @@ void Chip8::Tick() {
           display[x + xLine + ((y + yLine) * 64)] ^= 1;
         }
       }
+
+      dirtyRows |= 1u << (y + yLine);
     }
 
     pc += 2;
     redraw = true;
 
+    if (probe != nullptr) {
+      probe->DisplayChanged(cycles);
+    }
+
     break;
   }
 
@@ -324,6 +395,10 @@ void Chip8::Tick() {
     switch (opcode & 0x00FF) {
     // EX9E (Skip an instruction if key stored in vX is true)
     case 0x009E: {
+      if (probe != nullptr) {
+        probe->KeyObserved(reg[(opcode & 0x0F00) >> 8] & 0xF, cycles);
+      }
+
       if (keypadState[reg[(opcode & 0x0F00) >> 8]]) {
         pc += 2;
       }
@@ -334,6 +409,10 @@ void Chip8::Tick() {
 
     // EXA1 (Skip an instruction if key stored in vX is false)
     case 0x00A1: {
+      if (probe != nullptr) {
+        probe->KeyObserved(reg[(opcode & 0x0F00) >> 8] & 0xF, cycles);
+      }
+
       if (!keypadState[reg[(opcode & 0x0F00) >> 8]]) {
         pc += 2;
       }
@@ -374,11 +453,17 @@ void Chip8::Tick() {
       }
 
       // If not pressed, return without changing the PC. This will case this
-      // instruction to be executed again on the next clock tick
+      // instruction to be executed again on the next clock tick. The driver
+      // sees waitingForKey and can park instead of spinning on it
+      waitingForKey = !pressed;
       if (!pressed) {
         return;
       }
 
+      if (probe != nullptr) {
+        probe->KeyObserved(reg[(opcode & 0x0F00) >> 8], cycles);
+      }
+
       pc += 2;
       break;
     }
@@ -424,6 +509,8 @@ void Chip8::Tick() {
       mem[index] = reg[(opcode & 0x0F00) >> 8] / 100;
       mem[index + 1] = (reg[(opcode & 0x0F00) >> 8] / 10) % 10;
       mem[index + 2] = (reg[(opcode & 0x0F00) >> 8] % 100) % 10;
+      written(index, 3);
+      bcdAddress = index;
 
       pc += 2;
       break;
@@ -434,6 +521,7 @@ void Chip8::Tick() {
       for (int i = 0; i <= ((opcode & 0x0F00) >> 8); ++i) {
         mem[index + i] = reg[i];
       }
+      written(index, ((opcode & 0x0F00) >> 8) + 1);
 
       index += ((opcode & 0x0F00) >> 8) + 1;
       pc += 2;
@@ -467,7 +555,7 @@ void Chip8::Tick() {
     break;
   }
 
-  if (invalid) {
+  if (invalid && !speculative) {
     std::cerr << "Invalid opcode: " << opcode << std::endl;
   }
 }
@@ -485,4 +573,21 @@ void Chip8::TickTimer() {
     soundTimer--;
   }
 }
+
+int Chip8::RunFrame(int budget) {
+  // One 60Hz frame: up to `budget` instructions followed by a timer tick.
+  // Stops early when parked on FX0A
+  int executed = 0;
+  while (executed < budget) {
+    Tick();
+    executed++;
+
+    if (waitingForKey) {
+      break;
+    }
+  }
+
+  TickTimer();
+  return executed;
+}
 } // namespace chip8
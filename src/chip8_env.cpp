@@ -0,0 +1,264 @@
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <new>
+#include <vector>
+
+#include "batch.hpp"
+#include "chip8.hpp"
+#include "chip8_env.h"
+#include "observation.hpp"
+#include "thread_pool.hpp"
+#include "watch.hpp"
+
+#define CHIP8_ENV_CHUNK 16 // Instances per pool task
+
+static_assert(sizeof(bool) == 1, "plain observations are copied straight "
+                                 "from the display");
+
+struct chip8_env {
+  chip8_env_options options;
+  chip8::Chip8 initial; // State right after loading the ROM
+
+  std::vector<chip8::Chip8> machines;
+  std::vector<uint32_t> steps;    // Steps into the current episode
+  std::vector<uint32_t> episodes; // Episodes started, for fresh seeds
+  std::vector<uint8_t> score;     // Last value at reward_address
+
+  // Packed frames behind observations, none for a plain byte frame
+  std::vector<chip8::FrameStack> stacks;
+  size_t obsSize = 0;                    // Bytes per instance
+
+  chip8::Watch watch;                     // As compiled by chip8_env_add_watch
+  std::vector<chip8::WatchState> watching; // What it saw, per instance
+
+  std::unique_ptr<chip8::ThreadPool> pool;
+};
+
+static void resetInstance(chip8_env *env, int i) {
+  auto &c8 = env->machines[i];
+  c8 = env->initial;
+
+  // Every episode of every instance rolls different numbers
+  c8.Seed(env->options.seed + i +
+          env->episodes[i] * (uint32_t)env->options.instances);
+  env->episodes[i]++;
+  env->steps[i] = 0;
+
+  if (env->options.reward_address >= 0) {
+    env->score[i] = c8.mem[env->options.reward_address];
+  }
+
+  env->watch.Attach(c8, env->watching[i]);
+
+  if (!env->stacks.empty()) {
+    env->stacks[i].Clear();
+    env->stacks[i].Push(c8);
+  }
+}
+
+static void writeObservation(chip8_env *env, int i, void *obs) {
+  auto *out = (uint8_t *)obs + (size_t)i * env->obsSize;
+
+  if (env->stacks.empty()) {
+    memcpy(out, env->machines[i].display.data(), CHIP8_ENV_OBS_SIZE);
+  } else if (env->options.obs_format == CHIP8_ENV_OBS_FLOAT) {
+    env->stacks[i].ExpandFloat((float *)out);
+  } else {
+    env->stacks[i].ExpandU8(out, 1);
+  }
+}
+
+static void stepInstance(chip8_env *env, int i, uint16_t action, void *obs,
+                         float *reward, uint8_t *done) {
+  auto &options = env->options;
+  auto &c8 = env->machines[i];
+
+  for (int key = 0; key < 16; key++) {
+    c8.SetKey(key, (action >> key) & 1);
+  }
+
+  for (int frame = 0; frame < options.frames_per_step; frame++) {
+    c8.RunFrame(options.cycles_per_frame);
+  }
+
+  env->steps[i]++;
+  if (!env->stacks.empty()) {
+    env->stacks[i].Push(c8);
+  }
+
+  chip8::WatchResult watched = env->watch.Evaluate(c8, env->watching[i]);
+
+  if (reward != nullptr) {
+    reward[i] = watched.reward;
+    if (options.reward_address >= 0) {
+      uint8_t score = c8.mem[options.reward_address];
+      reward[i] += (float)score - env->score[i];
+      env->score[i] = score;
+    }
+  }
+
+  // Keys keep coming, so only a jump onto itself ends an episode early
+  bool finished =
+      watched.done ||
+      chip8::Halted(c8, false) == chip8::HaltReason::SelfJump ||
+      (options.max_steps != 0 && env->steps[i] >= options.max_steps);
+
+  if (finished) {
+    resetInstance(env, i);
+  }
+
+  if (done != nullptr) {
+    done[i] = finished;
+  }
+
+  if (obs != nullptr) {
+    writeObservation(env, i, obs);
+  }
+}
+
+extern "C" {
+void chip8_env_default_options(chip8_env_options *options) {
+  options->instances = 1;
+  options->cycles_per_frame = 960 / 60;
+  options->frames_per_step = 1;
+  options->seed = 1;
+  options->threads = 0;
+  options->reward_address = -1;
+  options->max_steps = 0;
+  options->obs_format = CHIP8_ENV_OBS_U8;
+  options->frame_stack = 1;
+  options->max_pool = 0;
+}
+
+chip8_env *chip8_env_create(const uint8_t *rom, size_t size,
+                            const chip8_env_options *options) {
+  if (rom == nullptr || options == nullptr || options->instances <= 0 ||
+      options->cycles_per_frame < 0 || options->frames_per_step <= 0 ||
+      options->reward_address >= 4096 ||
+      (options->obs_format != CHIP8_ENV_OBS_U8 &&
+       options->obs_format != CHIP8_ENV_OBS_FLOAT) ||
+      options->frame_stack <= 0) {
+    return nullptr;
+  }
+
+  // No exceptions across the C boundary
+  std::unique_ptr<chip8_env> env(new (std::nothrow) chip8_env());
+  if (env == nullptr) {
+    return nullptr;
+  }
+
+  try {
+    env->options = *options;
+
+    env->initial.Reset();
+    if (!env->initial.LoadProgram(rom, size)) {
+      return nullptr;
+    }
+
+    env->machines.resize(options->instances);
+    env->steps.resize(options->instances);
+    env->episodes.resize(options->instances);
+    env->score.resize(options->instances);
+    env->watching.resize(options->instances);
+
+    if (options->obs_format != CHIP8_ENV_OBS_U8 || options->frame_stack > 1 ||
+        options->max_pool) {
+      env->stacks.reserve(options->instances);
+      for (int i = 0; i < options->instances; i++) {
+        env->stacks.emplace_back(options->frame_stack, options->max_pool != 0);
+      }
+    }
+
+    env->obsSize = (size_t)options->frame_stack * CHIP8_ENV_OBS_SIZE *
+                   (options->obs_format == CHIP8_ENV_OBS_FLOAT ? sizeof(float)
+                                                               : 1);
+
+    if (options->threads > 1) {
+      env->pool = std::make_unique<chip8::ThreadPool>(options->threads);
+    }
+
+    chip8_env_reset(env.get(), nullptr);
+  } catch (const std::exception &) {
+    // bad_alloc, or system_error when the workers can't be started
+    return nullptr;
+  }
+
+  return env.release();
+}
+
+void chip8_env_destroy(chip8_env *env) { delete env; }
+
+size_t chip8_env_obs_size(const chip8_env *env) { return env->obsSize; }
+
+void chip8_env_reset(chip8_env *env, void *out_obs) {
+  for (int i = 0; i < env->options.instances; i++) {
+    resetInstance(env, i);
+
+    if (out_obs != nullptr) {
+      writeObservation(env, i, out_obs);
+    }
+  }
+}
+
+int chip8_env_step(chip8_env *env, const uint16_t *actions, void *out_obs,
+                   float *out_reward, uint8_t *out_done) {
+  if (env == nullptr || actions == nullptr) {
+    return -1;
+  }
+
+  int instances = env->options.instances;
+
+  if (env->pool == nullptr) {
+    for (int i = 0; i < instances; i++) {
+      stepInstance(env, i, actions[i], out_obs, out_reward, out_done);
+    }
+
+    return 0;
+  }
+
+  // Instances only touch their own slots of the output buffers
+  for (int first = 0; first < instances; first += CHIP8_ENV_CHUNK) {
+    int last = std::min(first + CHIP8_ENV_CHUNK, instances);
+    env->pool->Submit([=](int) {
+      for (int i = first; i < last; i++) {
+        stepInstance(env, i, actions[i], out_obs, out_reward, out_done);
+      }
+    });
+  }
+
+  env->pool->Wait();
+  return 0;
+}
+
+int chip8_env_add_watch(chip8_env *env, const char *expression, int done,
+                        float reward) {
+  if (env == nullptr || expression == nullptr) {
+    return -1;
+  }
+
+  try {
+    if (!env->watch.Add(expression,
+                        done ? chip8::WatchSignal::Done
+                             : chip8::WatchSignal::Reward,
+                        reward)) {
+      return -1;
+    }
+
+    // Running episodes pick it up from here on
+    for (int i = 0; i < env->options.instances; i++) {
+      env->watch.Attach(env->machines[i], env->watching[i]);
+    }
+  } catch (const std::exception &) {
+    // bad_alloc, nothing may leave through the C API
+    return -1;
+  }
+
+  return 0;
+}
+
+int chip8_env_instances(const chip8_env *env) {
+  return env->options.instances;
+}
+}
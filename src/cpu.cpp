@@ -0,0 +1,12 @@
+#include "cpu.hpp"
+
+namespace chip8 {
+bool HasAVX2() {
+#ifdef CHIP8_AVX2_KERNELS
+  static const bool avx2 = __builtin_cpu_supports("avx2");
+  return avx2;
+#else
+  return false;
+#endif
+}
+} // namespace chip8
@@ -0,0 +1,267 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include <GLFW/glfw3.h>
+
+#include "display_renderer.hpp"
+
+// Covers the viewport with one triangle, no vertex buffer needed
+static const char *vertexSource = R"(
+void main() {
+  gl_Position = vec4(gl_VertexID == 1 ? 3.0 : -1.0,
+                     gl_VertexID == 2 ? 3.0 : -1.0, 0.0, 1.0);
+}
+)";
+
+static const char *fragmentSource = R"(
+uniform usampler2D bits;
+uniform vec3 fg;
+uniform vec3 bg;
+uniform vec2 origin; // Window position of the display's top left corner
+uniform vec2 scale;  // Display pixels per window pixel, y < 0 flips
+
+out vec4 color;
+
+void main() {
+  // An atlas holds a grid of displays side by side
+  ivec2 cells = textureSize(bits, 0) / ivec2(8, 32);
+
+  vec2 position = (gl_FragCoord.xy - origin) * scale;
+  ivec2 pixel = clamp(ivec2(position), ivec2(0), cells * ivec2(64, 32) - 1);
+  uint byte = texelFetch(bits, ivec2(pixel.x / 8, pixel.y), 0).r;
+  bool lit = ((byte >> uint(pixel.x % 8)) & 1u) != 0u;
+  color = vec4(lit ? fg : bg, 1.0);
+
+  // A one pixel line between neighbouring displays
+  bvec2 edge = lessThan(mod(position, vec2(64.0, 32.0)), abs(scale));
+  if ((edge.x && pixel.x >= 64) || (edge.y && pixel.y >= 32)) {
+    color = vec4(mix(bg, fg, 0.25), 1.0);
+  }
+}
+)";
+
+namespace chip8 {
+GLuint DisplayRenderer::compile(GLenum type, const char *glslVersion,
+                                const char *source) {
+  const char *sources[] = {glslVersion, "\n", source};
+
+  GLuint shader = gl.CreateShader(type);
+  gl.ShaderSource(shader, 3, sources, nullptr);
+  gl.CompileShader(shader);
+
+  GLint ok = 0;
+  gl.GetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+  if (!ok) {
+    char log[1024] = "";
+    gl.GetShaderInfoLog(shader, sizeof(log), nullptr, log);
+    std::cerr << "Display shader: " << log << std::endl;
+    gl.DeleteShader(shader);
+    return 0;
+  }
+
+  return shader;
+}
+
+bool DisplayRenderer::Init(const char *glslVersion, int width, int height,
+                           int columns, int rows) {
+  this->width = width;
+  this->height = height;
+  gridColumns = columns;
+  gridRows = rows;
+
+  // GLSL ES 1.00 has neither integer textures nor texelFetch
+  if (strcmp(glslVersion, "#version 100") == 0 || !gl.Load()) {
+    return false;
+  }
+
+  GLuint vertex = compile(GL_VERTEX_SHADER, glslVersion, vertexSource);
+  GLuint fragment = compile(GL_FRAGMENT_SHADER, glslVersion, fragmentSource);
+  if (vertex == 0 || fragment == 0) {
+    return false;
+  }
+
+  program = gl.CreateProgram();
+  gl.AttachShader(program, vertex);
+  gl.AttachShader(program, fragment);
+  gl.LinkProgram(program);
+  gl.DeleteShader(vertex);
+  gl.DeleteShader(fragment);
+
+  GLint linked = 0;
+  gl.GetProgramiv(program, GL_LINK_STATUS, &linked);
+  if (!linked) {
+    char log[1024] = "";
+    gl.GetProgramInfoLog(program, sizeof(log), nullptr, log);
+    std::cerr << "Display shader: " << log << std::endl;
+    return false;
+  }
+
+  fgLocation = gl.GetUniformLocation(program, "fg");
+  bgLocation = gl.GetUniformLocation(program, "bg");
+  originLocation = gl.GetUniformLocation(program, "origin");
+  scaleLocation = gl.GetUniformLocation(program, "scale");
+
+  GLint lastTexture;
+  glGetIntegerv(GL_TEXTURE_BINDING_2D, &lastTexture);
+
+  // Integer textures can't be filtered, nearest it is
+  glGenTextures(1, &bits);
+  glBindTexture(GL_TEXTURE_2D, bits);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_R8UI, 8 * columns, 32 * rows, 0,
+               GL_RED_INTEGER, GL_UNSIGNED_BYTE, nullptr);
+
+  glGenTextures(1, &output);
+  glBindTexture(GL_TEXTURE_2D, output);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, width, height, 0, GL_RGB,
+               GL_UNSIGNED_BYTE, nullptr);
+
+  glBindTexture(GL_TEXTURE_2D, lastTexture);
+
+  GLint lastFramebuffer;
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &lastFramebuffer);
+
+  gl.GenFramebuffers(1, &framebuffer);
+  gl.BindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  gl.FramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                          output, 0);
+  bool complete =
+      gl.CheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+  gl.BindFramebuffer(GL_FRAMEBUFFER, lastFramebuffer);
+
+  // Core profiles draw nothing without a vertex array bound
+  gl.GenVertexArrays(1, &vao);
+
+  return complete && glGetError() == GL_NO_ERROR;
+}
+
+void DisplayRenderer::Upload(const PackedFrame frame, uint32_t rows) {
+  if (rows == 0) {
+    return;
+  }
+
+  int first = 0;
+  while (!((rows >> first) & 1)) {
+    first++;
+  }
+
+  int last = 31;
+  while (!((rows >> last) & 1)) {
+    last--;
+  }
+
+  // Spelled out byte by byte, the words' memory layout depends on endianness
+  uint8_t bytes[OBSERVATION_HEIGHT][8];
+  for (int y = first; y <= last; y++) {
+    for (int i = 0; i < 8; i++) {
+      bytes[y][i] = frame[y] >> (i * 8);
+    }
+  }
+
+  GLint lastTexture;
+  glGetIntegerv(GL_TEXTURE_BINDING_2D, &lastTexture);
+
+  glBindTexture(GL_TEXTURE_2D, bits);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, first, 8, last - first + 1,
+                  GL_RED_INTEGER, GL_UNSIGNED_BYTE, bytes[first]);
+  glBindTexture(GL_TEXTURE_2D, lastTexture);
+}
+
+void DisplayRenderer::UploadAtlas(const uint64_t *frames, int count) {
+  int stride = 8 * gridColumns;
+  atlas.assign((size_t)stride * 32 * gridRows, 0);
+
+  count = std::min(count, gridColumns * gridRows);
+  for (int cell = 0; cell < count; cell++) {
+    const uint64_t *frame = frames + cell * OBSERVATION_HEIGHT;
+    int row = cell / gridColumns;
+    int column = cell % gridColumns;
+    uint8_t *out = &atlas[row * 32 * stride + column * 8];
+
+    for (int y = 0; y < OBSERVATION_HEIGHT; y++) {
+      for (int i = 0; i < 8; i++) {
+        out[y * stride + i] = frame[y] >> (i * 8);
+      }
+    }
+  }
+
+  GLint lastTexture;
+  glGetIntegerv(GL_TEXTURE_BINDING_2D, &lastTexture);
+
+  glBindTexture(GL_TEXTURE_2D, bits);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, stride, 32 * gridRows,
+                  GL_RED_INTEGER, GL_UNSIGNED_BYTE, atlas.data());
+  glBindTexture(GL_TEXTURE_2D, lastTexture);
+}
+
+void DisplayRenderer::Draw(const float fg[3], const float bg[3]) {
+  // Row 0 of the output is the top row, ImGui shows textures that way up
+  draw(framebuffer, 0, 0, width, height, false, fg, bg);
+}
+
+void DisplayRenderer::Present(int x, int y, int width, int height,
+                              const float fg[3], const float bg[3]) {
+  draw(0, x, y, width, height, true, fg, bg);
+}
+
+void DisplayRenderer::draw(GLuint target, int x, int y, int width, int height,
+                           bool flip, const float fg[3], const float bg[3]) {
+  // Called while ImGui builds its frame, leave things as they were
+  GLint lastFramebuffer, lastProgram, lastVao, lastTexture, lastActive;
+  GLint lastViewport[4];
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &lastFramebuffer);
+  glGetIntegerv(GL_CURRENT_PROGRAM, &lastProgram);
+  glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &lastVao);
+  glGetIntegerv(GL_ACTIVE_TEXTURE, &lastActive);
+  gl.ActiveTexture(GL_TEXTURE0);
+  glGetIntegerv(GL_TEXTURE_BINDING_2D, &lastTexture);
+  glGetIntegerv(GL_VIEWPORT, lastViewport);
+  GLboolean blend = glIsEnabled(GL_BLEND);
+  GLboolean scissor = glIsEnabled(GL_SCISSOR_TEST);
+
+  glDisable(GL_BLEND);
+  glDisable(GL_SCISSOR_TEST);
+
+  gl.BindFramebuffer(GL_FRAMEBUFFER, target);
+  glViewport(x, y, width, height);
+
+  gl.UseProgram(program);
+  gl.Uniform3f(fgLocation, fg[0], fg[1], fg[2]);
+  gl.Uniform3f(bgLocation, bg[0], bg[1], bg[2]);
+
+  // Window framebuffers start at the bottom, the display at the top
+  if (flip) {
+    gl.Uniform2f(originLocation, x, y + height);
+    gl.Uniform2f(scaleLocation, 64.0f * gridColumns / width,
+                 -32.0f * gridRows / height);
+  } else {
+    gl.Uniform2f(originLocation, x, y);
+    gl.Uniform2f(scaleLocation, 64.0f * gridColumns / width,
+                 32.0f * gridRows / height);
+  }
+
+  glBindTexture(GL_TEXTURE_2D, bits);
+  gl.BindVertexArray(vao);
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+
+  gl.BindVertexArray(lastVao);
+  glBindTexture(GL_TEXTURE_2D, lastTexture);
+  gl.ActiveTexture(lastActive);
+  gl.UseProgram(lastProgram);
+  gl.BindFramebuffer(GL_FRAMEBUFFER, lastFramebuffer);
+  glViewport(lastViewport[0], lastViewport[1], lastViewport[2],
+             lastViewport[3]);
+
+  if (blend) {
+    glEnable(GL_BLEND);
+  }
+
+  if (scissor) {
+    glEnable(GL_SCISSOR_TEST);
+  }
+}
+} // namespace chip8
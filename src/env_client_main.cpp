@@ -0,0 +1,137 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#include "env_server.hpp"
+
+// Test client for chip8_env_server. Steps with random keys and reports the
+// round trip time of every batch step
+
+static void usage(const char *argv0) {
+  std::cerr << "Usage:" << std::endl
+            << argv0 << " [options]" << std::endl
+            << std::endl
+            << "  --name s   Segment name (default chip8)" << std::endl
+            << "  --steps n  Batch steps to run (default 10000)" << std::endl
+            << "  --stop     Stop the server afterwards" << std::endl;
+}
+
+int main(int args, char **argv) {
+  std::string name = "chip8";
+  int steps = 10000;
+  bool stop = false;
+
+  for (int i = 1; i < args; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < args;
+
+    if (arg == "--name" && hasValue) {
+      name = argv[++i];
+    } else if (arg == "--steps" && hasValue) {
+      steps = atoi(argv[++i]);
+    } else if (arg == "--stop") {
+      stop = true;
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  chip8::EnvClient client;
+  if (!client.Connect(name)) {
+    std::cerr << "No server running as '" << name << "'" << std::endl;
+    return -1;
+  }
+
+  int instances = client.Instances();
+  size_t obsSize = client.ObsSize();
+  bool floats = client.ObsFormat() == CHIP8_ENV_OBS_FLOAT;
+  size_t newest = (client.ObsDepth() - 1) * (size_t)CHIP8_ENV_OBS_SIZE;
+  client.Wait(client.Submit(chip8::EnvCommand::Reset));
+
+  std::vector<double> micros;
+  micros.reserve(steps);
+
+  uint64_t stepNanos = client.StepNanos();
+  uint64_t done = 0;
+  uint64_t lit = 0;
+  uint32_t rng = 0x2545F491;
+
+  auto begin = std::chrono::steady_clock::now();
+  for (int step = 0; step < steps && !client.Lost(); step++) {
+    chip8::EnvSlot slot = client.Next();
+    if (client.Lost()) {
+      break;
+    }
+
+    for (int i = 0; i < instances; i++) {
+      rng ^= rng << 13;
+      rng ^= rng >> 17;
+      rng ^= rng << 5;
+      slot.actions[i] = 1 << (rng >> 28);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    slot = client.Wait(client.Submit());
+    micros.push_back(std::chrono::duration<double, std::micro>(
+                         std::chrono::steady_clock::now() - start)
+                         .count());
+
+    if (client.Lost()) {
+      break;
+    }
+
+    // Read the results where they are, like a trainer would
+    for (int i = 0; i < instances; i++) {
+      done += slot.done[i];
+      // First pixel of the newest frame
+      const uint8_t *obs = slot.obs + i * obsSize;
+      lit += floats ? ((const float *)obs)[newest] != 0 : obs[newest] != 0;
+    }
+  }
+
+  if (client.Lost()) {
+    std::cerr << "Server '" << name << "' went away" << std::endl;
+    return -1;
+  }
+
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - begin)
+                       .count();
+  stepNanos = client.StepNanos() - stepNanos;
+
+  if (stop) {
+    client.Submit(chip8::EnvCommand::Stop);
+  }
+
+  if (micros.empty()) {
+    return 0;
+  }
+
+  std::sort(micros.begin(), micros.end());
+  double mean = 0;
+  for (double m : micros) {
+    mean += m;
+  }
+  mean /= micros.size();
+
+  std::cout << "Steps:      " << steps << " x " << instances
+            << " instances in " << seconds << "s ("
+            << steps * instances / seconds << " instance steps/s)"
+            << std::endl
+            << "Round trip: mean " << mean << "us, p50 "
+            << micros[micros.size() / 2] << "us, p99 "
+            << micros[micros.size() * 99 / 100] << "us, max "
+            << micros.back() << "us" << std::endl
+            << "Stepping:   mean " << stepNanos / 1000.0 / steps
+            << "us per batch step on the server" << std::endl
+            << "Episodes:   " << done << " finished" << std::endl
+            << "Obs:        " << client.ObsDepth() << " x 64x32 "
+            << (floats ? "float" : "u8") << ", " << obsSize
+            << " bytes per instance" << std::endl;
+
+  return 0;
+}
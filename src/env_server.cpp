@@ -0,0 +1,283 @@
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "env_server.hpp"
+
+#define ENV_SERVER_SPIN 4000 // Polls before sleeping, with spare cores
+
+namespace chip8 {
+static size_t align64(size_t n) { return (n + 63) & ~(size_t)63; }
+
+static size_t slotSize(uint32_t instances, size_t obsSize) {
+  return align64(sizeof(uint32_t)) + align64(instances * sizeof(uint16_t)) +
+         align64(instances * sizeof(float)) + align64(instances) +
+         align64(instances * obsSize);
+}
+
+static size_t segmentSize(uint32_t instances, size_t obsSize) {
+  return align64(sizeof(EnvRingHeader)) +
+         ENV_SERVER_SLOTS * slotSize(instances, obsSize);
+}
+
+static EnvSlot slot(EnvRingHeader *header, uint32_t ticket) {
+  auto *p = (uint8_t *)header + align64(sizeof(EnvRingHeader)) +
+            (ticket % ENV_SERVER_SLOTS) * (size_t)header->slotSize;
+  uint32_t n = header->instances;
+
+  EnvSlot s;
+  s.command = (uint32_t *)p;
+  p += align64(sizeof(uint32_t));
+  s.actions = (uint16_t *)p;
+  p += align64(n * sizeof(uint16_t));
+  s.reward = (float *)p;
+  p += align64(n * sizeof(float));
+  s.done = p;
+  p += align64(n);
+  s.obs = p;
+  return s;
+}
+
+static std::string segmentName(const std::string &name) {
+  return "/chip8-env-" + name;
+}
+
+// Spinning before a futex wait saves the round trip when the other side
+// answers quickly, but only helps if it has a core of its own. True if word
+// changed while spinning
+static bool spinWhile(std::atomic<uint32_t> &word, uint32_t value) {
+  static const bool spin = std::thread::hardware_concurrency() > 1;
+
+  for (int i = 0; spin && i < ENV_SERVER_SPIN; i++) {
+    if (word.load(std::memory_order_acquire) != value) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// Sleeps until word no longer holds value, or until timeout if there is one
+static void futexWait(std::atomic<uint32_t> &word, uint32_t value,
+                      const timespec *timeout) {
+  syscall(SYS_futex, (uint32_t *)&word, FUTEX_WAIT, value, timeout, nullptr,
+          0);
+}
+
+// The server has nobody to wait for but its client
+static void waitWhile(std::atomic<uint32_t> &word, uint32_t value) {
+  if (spinWhile(word, value)) {
+    return;
+  }
+
+  while (word.load(std::memory_order_acquire) == value) {
+    futexWait(word, value, nullptr);
+  }
+}
+
+static void wake(std::atomic<uint32_t> &word) {
+  syscall(SYS_futex, (uint32_t *)&word, FUTEX_WAKE, INT_MAX, nullptr, nullptr,
+          0);
+}
+
+EnvServer::~EnvServer() {
+  if (env != nullptr) {
+    chip8_env_destroy(env);
+  }
+
+  if (memory != nullptr) {
+    munmap(memory, size);
+    shm_unlink(segmentName(name).c_str());
+  }
+
+  if (fd != -1) {
+    close(fd);
+  }
+}
+
+std::string EnvServer::Segment() const { return segmentName(name); }
+
+bool EnvServer::Start(const std::string &name, const uint8_t *rom,
+                      size_t romSize, const chip8_env_options &options) {
+  env = chip8_env_create(rom, romSize, &options);
+  if (env == nullptr) {
+    std::cerr << "Unable to create the environment" << std::endl;
+    return false;
+  }
+
+  this->name = name;
+  size_t obsSize = chip8_env_obs_size(env);
+  size = segmentSize(options.instances, obsSize);
+
+  fd = shm_open(segmentName(name).c_str(), O_CREAT | O_RDWR | O_TRUNC, 0600);
+  if (fd == -1 || ftruncate(fd, size) != 0 || flock(fd, LOCK_EX) != 0) {
+    std::cerr << "Unable to create " << segmentName(name) << std::endl;
+    return false;
+  }
+
+  memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+  if (memory == MAP_FAILED) {
+    memory = nullptr;
+    return false;
+  }
+
+  // ftruncate zero fills, so head, tail and magic start at 0
+  header = (EnvRingHeader *)memory;
+  header->instances = options.instances;
+  header->slotSize = slotSize(options.instances, obsSize);
+  header->obsFormat = options.obs_format;
+  header->obsDepth = options.frame_stack;
+  header->obsSize = obsSize;
+  header->magic.store(ENV_SERVER_MAGIC, std::memory_order_release);
+
+  return true;
+}
+
+void EnvServer::Serve() {
+  while (true) {
+    uint32_t ticket = header->tail.load(std::memory_order_relaxed);
+    waitWhile(header->head, ticket);
+
+    EnvSlot s = slot(header, ticket);
+    auto command = (EnvCommand)*s.command;
+    auto start = std::chrono::steady_clock::now();
+
+    if (command == EnvCommand::Step) {
+      chip8_env_step(env, s.actions, s.obs, s.reward, s.done);
+      steps++;
+    } else if (command == EnvCommand::Reset) {
+      chip8_env_reset(env, s.obs);
+      memset(s.reward, 0, header->instances * sizeof(float));
+      memset(s.done, 0, header->instances);
+    }
+
+    header->stepNanos += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+
+    header->tail.store(ticket + 1, std::memory_order_release);
+    wake(header->tail);
+
+    if (command == EnvCommand::Stop) {
+      return;
+    }
+  }
+}
+
+EnvClient::~EnvClient() {
+  if (memory != nullptr) {
+    munmap(memory, size);
+  }
+
+  if (fd != -1) {
+    close(fd);
+  }
+}
+
+bool EnvClient::Connect(const std::string &name) {
+  fd = shm_open(segmentName(name).c_str(), O_RDWR, 0);
+  if (fd == -1) {
+    return false;
+  }
+
+  // The header alone first, the size of the rest depends on it
+  EnvRingHeader peek;
+  bool ok = pread(fd, &peek, sizeof(peek), 0) == sizeof(peek) &&
+            peek.magic.load() == ENV_SERVER_MAGIC;
+
+  if (ok) {
+    size = segmentSize(peek.instances, peek.obsSize);
+    memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ok = memory != MAP_FAILED;
+    if (!ok) {
+      memory = nullptr;
+    }
+  }
+
+  if (ok) {
+    header = (EnvRingHeader *)memory;
+  } else {
+    close(fd);
+    fd = -1;
+  }
+
+  return ok;
+}
+
+// Like the server's, but gives up once the server no longer holds its lock
+bool EnvClient::waitWhile(std::atomic<uint32_t> &word, uint32_t value) {
+  if (spinWhile(word, value)) {
+    return true;
+  }
+
+  const timespec poll = {ENV_SERVER_POLL_MS / 1000,
+                         ENV_SERVER_POLL_MS % 1000 * 1000000L};
+
+  while (word.load(std::memory_order_acquire) == value) {
+    futexWait(word, value, &poll);
+
+    if (word.load(std::memory_order_acquire) != value) {
+      break;
+    }
+
+    // Only one of us gets the lock while the server is up
+    if (flock(fd, LOCK_SH | LOCK_NB) == 0) {
+      flock(fd, LOCK_UN);
+      lost = true;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+EnvSlot EnvClient::Next() {
+  uint32_t head = header->head.load(std::memory_order_relaxed);
+
+  uint32_t tail;
+  while (head - (tail = header->tail.load(std::memory_order_acquire)) >=
+         ENV_SERVER_SLOTS) {
+    if (!waitWhile(header->tail, tail)) {
+      return EnvSlot{};
+    }
+  }
+
+  return slot(header, head);
+}
+
+uint32_t EnvClient::Submit(EnvCommand command) {
+  EnvSlot s = Next();
+  if (s.command == nullptr) {
+    return header->head.load(std::memory_order_relaxed);
+  }
+
+  *s.command = (uint32_t)command;
+
+  uint32_t ticket = header->head.load(std::memory_order_relaxed);
+  header->head.store(ticket + 1, std::memory_order_release);
+  wake(header->head);
+  return ticket;
+}
+
+EnvSlot EnvClient::Wait(uint32_t ticket) {
+  uint32_t tail;
+  while ((int32_t)(ticket - (tail = header->tail.load(
+                                 std::memory_order_acquire))) >= 0) {
+    if (!waitWhile(header->tail, tail)) {
+      return EnvSlot{};
+    }
+  }
+
+  return slot(header, ticket);
+}
+} // namespace chip8
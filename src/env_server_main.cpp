@@ -0,0 +1,119 @@
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/mman.h>
+#include <vector>
+
+#include "env_server.hpp"
+
+static char segment[256]; // Copied up front, the handler can't allocate
+
+// Ctrl+C or kill would otherwise leave the segment behind in /dev/shm
+static void onSignal(int sig) {
+  shm_unlink(segment);
+  signal(sig, SIG_DFL);
+  raise(sig);
+}
+
+static void usage(const char *argv0) {
+  std::cerr << "Usage:" << std::endl
+            << argv0 << " [options] path/to/chip8/program" << std::endl
+            << std::endl
+            << "  --name s             Segment name (default chip8)"
+            << std::endl
+            << "  --instances n        Machines (default 64)" << std::endl
+            << "  --threads n          Worker threads (default 1)" << std::endl
+            << "  --clock hz           Instructions per second (default 960)"
+            << std::endl
+            << "  --frames-per-step n  Frames per action (default 1)"
+            << std::endl
+            << "  --reward-address hex Byte whose change is the reward"
+            << std::endl
+            << "  --max-steps n        Episode length limit" << std::endl
+            << "  --obs u8|float       Observation planes (default u8)"
+            << std::endl
+            << "  --frame-stack n      Frames per observation (default 1)"
+            << std::endl
+            << "  --max-pool           OR every frame with the one before"
+            << std::endl;
+}
+
+int main(int args, char **argv) {
+  const char *romFile = NULL;
+  std::string name = "chip8";
+
+  chip8_env_options options;
+  chip8_env_default_options(&options);
+  options.instances = 64;
+
+  for (int i = 1; i < args; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < args;
+
+    if (arg == "--name" && hasValue) {
+      name = argv[++i];
+    } else if (arg == "--instances" && hasValue) {
+      options.instances = atoi(argv[++i]);
+    } else if (arg == "--threads" && hasValue) {
+      options.threads = atoi(argv[++i]);
+    } else if (arg == "--clock" && hasValue) {
+      options.cycles_per_frame = atoi(argv[++i]) / 60;
+    } else if (arg == "--frames-per-step" && hasValue) {
+      options.frames_per_step = atoi(argv[++i]);
+    } else if (arg == "--reward-address" && hasValue) {
+      options.reward_address = strtol(argv[++i], NULL, 16);
+    } else if (arg == "--max-steps" && hasValue) {
+      options.max_steps = strtoul(argv[++i], NULL, 10);
+    } else if (arg == "--obs" && hasValue) {
+      std::string format = argv[++i];
+      options.obs_format =
+          format == "float" ? CHIP8_ENV_OBS_FLOAT
+          : format == "u8"  ? CHIP8_ENV_OBS_U8
+                            : -1; // chip8_env_create turns it down
+    } else if (arg == "--frame-stack" && hasValue) {
+      options.frame_stack = atoi(argv[++i]);
+    } else if (arg == "--max-pool") {
+      options.max_pool = 1;
+    } else if (arg[0] == '-') {
+      usage(argv[0]);
+      return 1;
+    } else {
+      romFile = argv[i];
+    }
+  }
+
+  if (romFile == NULL) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  std::ifstream ifile(romFile, std::ios::binary);
+  if (!ifile) {
+    std::cerr << "Unable to load " << romFile << std::endl;
+    return -1;
+  }
+
+  std::vector<uint8_t> rom(std::istreambuf_iterator<char>(ifile),
+                           (std::istreambuf_iterator<char>()));
+
+  chip8::EnvServer server;
+  if (!server.Start(name, rom.data(), rom.size(), options)) {
+    return -1;
+  }
+
+  strncpy(segment, server.Segment().c_str(), sizeof(segment) - 1);
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+
+  std::cerr << "Serving " << options.instances << " instances of " << romFile
+            << " as '" << name << "'" << std::endl;
+
+  server.Serve();
+
+  std::cerr << "Stopped after " << server.steps << " steps" << std::endl;
+  return 0;
+}
@@ -0,0 +1,62 @@
+#include <coroutine>
+#include <utility>
+
+#include "execution.hpp"
+
+namespace chip8 {
+Execution::Execution(Execution &&other) noexcept
+    : handle(std::exchange(other.handle, nullptr)) {}
+
+Execution &Execution::operator=(Execution &&other) noexcept {
+  if (this != &other) {
+    if (handle) {
+      handle.destroy();
+    }
+
+    handle = std::exchange(other.handle, nullptr);
+  }
+
+  return *this;
+}
+
+Execution::~Execution() {
+  if (handle) {
+    handle.destroy();
+  }
+}
+
+Suspend Execution::Resume() {
+  handle.resume();
+  return handle.promise().reason;
+}
+
+Execution Execute(Chip8 *c8, ExecutionControl *control) {
+  // Set once we stopped at the breakpoint at pc, so resuming runs that
+  // instruction instead of stopping on it again
+  bool stopped = false;
+
+  for (;;) {
+    while (control->budget > 0) {
+      if (!stopped && control->breakpoints[c8->pc & 0xFFF]) {
+        stopped = true;
+        co_yield Suspend::Breakpoint;
+        continue;
+      }
+
+      c8->Tick();
+      control->budget--;
+
+      // FX0A found no key, the driver can park us until the keypad changes.
+      // Resuming simply retries the instruction
+      if (c8->waitingForKey) {
+        co_yield Suspend::KeyWait;
+        continue;
+      }
+
+      stopped = false;
+    }
+
+    co_yield Suspend::Frame;
+  }
+}
+} // namespace chip8
@@ -0,0 +1,35 @@
+#include <GLFW/glfw3.h>
+
+#include "gl_loader.hpp"
+
+namespace chip8 {
+template <typename T> static bool load(T &function, const char *name) {
+  function = (T)glfwGetProcAddress(name);
+  return function != nullptr;
+}
+
+bool GLFunctions::Load() {
+  return load(CreateShader, "glCreateShader") &&
+         load(ShaderSource, "glShaderSource") &&
+         load(CompileShader, "glCompileShader") &&
+         load(GetShaderiv, "glGetShaderiv") &&
+         load(GetShaderInfoLog, "glGetShaderInfoLog") &&
+         load(DeleteShader, "glDeleteShader") &&
+         load(CreateProgram, "glCreateProgram") &&
+         load(AttachShader, "glAttachShader") &&
+         load(LinkProgram, "glLinkProgram") &&
+         load(GetProgramiv, "glGetProgramiv") &&
+         load(GetProgramInfoLog, "glGetProgramInfoLog") &&
+         load(UseProgram, "glUseProgram") &&
+         load(GetUniformLocation, "glGetUniformLocation") &&
+         load(Uniform1i, "glUniform1i") && load(Uniform1f, "glUniform1f") &&
+         load(Uniform2f, "glUniform2f") && load(Uniform3f, "glUniform3f") &&
+         load(GenFramebuffers, "glGenFramebuffers") &&
+         load(BindFramebuffer, "glBindFramebuffer") &&
+         load(FramebufferTexture2D, "glFramebufferTexture2D") &&
+         load(CheckFramebufferStatus, "glCheckFramebufferStatus") &&
+         load(GenVertexArrays, "glGenVertexArrays") &&
+         load(BindVertexArray, "glBindVertexArray") &&
+         load(ActiveTexture, "glActiveTexture");
+}
+} // namespace chip8
@@ -1,5 +1,9 @@
+#include <algorithm>
+#include <bit>
+#include <cfloat>
 #include <chrono>
 #include <cstdint>
+#include <cstring>
 
 #include <GLFW/glfw3.h>
 #include <imgui.h>
@@ -7,95 +11,289 @@
 #include "beep.hpp"
 #include "gui.hpp"
 
-using std::chrono::high_resolution_clock;
+using std::chrono::steady_clock;
 
 namespace chip8 {
-GUI::GUI(Chip8 *c8, GLuint texture, GLubyte *pixels) {
+GUI::GUI(Chip8 *c8, GLuint texture, GLubyte *pixels, Netplay *session,
+         DisplayRenderer *shader) {
   interp = c8;
+  netplay = session;
+  renderer = shader;
+  interp->probe = &latency;
   displayTexture = texture;
   displayPixels = pixels;
-  lastTimer = high_resolution_clock::now();
+  lastTimer = steady_clock::now();
+  lastUpdate = lastTimer;
   memoryEditor.Cols = 8;
+  interp->watchPages = ~0ULL; // The memory editor shows all of it
+  execution = Execute(interp, &control);
 }
 
-inline void GUI::Tick() {
-  // Get the keyboard state every tick only if the current window has focus
-  if (ImGui::IsWindowFocused()) {
+inline bool GUI::KeyDown(int key) {
+  if (kiosk != nullptr) {
+    return glfwGetKey(kiosk, keymap[key]) == GLFW_PRESS;
+  }
+
+  return ImGui::IsKeyDown(keymap[key]);
+}
+
+inline uint16_t GUI::LocalKeys() {
+  uint16_t keys = 0;
+
+  // Only read the keyboard if the display window has focus
+  if (displayFocused || kiosk != nullptr) {
     for (int i = 0; i < 16; i++) {
-      interp->keypadState[i] = ImGui::IsKeyDown(keymap[i]);
+      keys |= KeyDown(i) << i;
     }
   }
 
-  ticks++;
-  interp->Tick();
+  return keys;
 }
 
-inline void GUI::RenderDisplay(float framerate) {
-  ImGui::Begin("Display", NULL,
-               ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoCollapse |
-                   ImGuiWindowFlags_NoTitleBar);
+inline void GUI::ReadKeys() {
+  // Get the keyboard state only if the display window has focus
+  if (displayFocused || kiosk != nullptr) {
+    for (int i = 0; i < 16; i++) {
+      interp->SetKey(i, KeyDown(i));
+    }
+  }
+}
 
-  ImGui::SetWindowSize(
-      ImVec2(32 + (64 * DISPLAY_SCALE), 48 + (32 * DISPLAY_SCALE)));
+inline bool GUI::TickTimers() {
+  auto currentTime = steady_clock::now();
+  auto timerTicks = (currentTime - lastTimer) / TIMER_PERIOD;
+  lastTimer += timerTicks * TIMER_PERIOD;
+
+  // Catch up on every 60Hz tick we slept through. Once both timers hit zero
+  // the rest are no-ops
+  bool ticked = false;
+  for (; timerTicks > 0; timerTicks--) {
+    if (interp->delayTimer == 0 && interp->soundTimer == 0) {
+      break;
+    }
 
-  // Explicitly requested
-  if (tickRequested) {
-    tickRequested = false;
-    Tick();
+    interp->TickTimer();
+    ticked = true;
   }
 
-  // Tick the clock frequency divided by framerate. Not the best way, but heh
-  // it works while consuming sane amounts of CPU and GPU
-  for (int i = 0; i < (clockSpeed / framerate); i++) {
-    Tick();
+  return ticked;
+}
+
+inline void GUI::RunAhead() {
+  snapshot = *interp;
+
+  // Speculative frames run at the nominal 60Hz pace with the current input
+  interp->speculative = true;
+  for (int i = 0; i < runAhead; i++) {
+    interp->RunFrame(clockSpeed / 60);
   }
 
-  auto currentTime = high_resolution_clock::now();
-  if ((currentTime - lastTimer).count() >= 16666666) {
-    interp->TickTimer();
-    lastTimer = currentTime;
+  aheadDisplay = interp->display;
+  aheadRedraw = aheadRedraw || interp->redraw;
+
+  // Roll back. Anything the future frames flagged (beep, redraw) goes with it
+  *interp = snapshot;
+}
+
+bool GUI::Update(bool input) {
+  auto currentTime = steady_clock::now();
+  float deltaTime =
+      std::chrono::duration<float>(currentTime - lastUpdate).count();
+  lastUpdate = currentTime;
+
+  if (netplay != nullptr) {
+    // Netplay runs whole 60Hz frames so both sides agree on what a frame is.
+    // Falling far behind is not worth catching up on, the remote stalls too
+    auto frames = (currentTime - lastTimer) / TIMER_PERIOD;
+    lastTimer += frames * TIMER_PERIOD;
+    frames = std::min<long long>(frames, NETPLAY_MAX_ROLLBACK);
+
+    if (input) {
+      localKeys = LocalKeys();
+    }
+
+    bool advanced = false;
+    for (; frames > 0; frames--) {
+      advanced = netplay->AdvanceFrame(localKeys) || advanced;
+    }
+
+    if (interp->beep) {
+      interp->beep = false;
+      beep();
+    }
+
+    return advanced || interp->redraw;
+  }
+
+  if (input) {
+    ReadKeys();
+  }
+
+  auto startCycles = interp->cycles;
+
+  // Run as many cycles as the clock speed allows for the time since the last
+  // update, plus an explicitly requested one. Not the best way, but heh it
+  // works while consuming sane amounts of CPU and GPU
+  cycleBudget += clockSpeed * std::min(deltaTime, MAX_FRAME_TIME);
+  control.budget = (int)cycleBudget + (tickRequested ? 1 : 0);
+  cycleBudget -= (int)cycleBudget;
+  tickRequested = false;
+
+  if (control.budget > 0) {
+    switch (execution.Resume()) {
+    // FX0A found no key pressed. Park until the next frame brings input
+    // instead of spinning on the same instruction
+    case Suspend::KeyWait: {
+      cycleBudget = 0;
+      break;
+    }
+
+    // Pause right before the instruction at the breakpoint
+    case Suspend::Breakpoint: {
+      if (clockSpeed != 0) {
+        prevClockSpeed = clockSpeed;
+        clockSpeed = 0;
+      }
+
+      cycleBudget = 0;
+      break;
+    }
+
+    case Suspend::Frame:
+      break;
+    }
+
+    control.budget = 0;
   }
 
+  ticks += interp->cycles - startCycles;
+
+  bool timersTicked = TickTimers();
+
   if (interp->beep) {
     interp->beep = false;
     beep();
   }
 
-  if (interp->redraw) {
+  bool changed =
+      interp->cycles != startCycles || timersTicked || interp->redraw;
+  if (changed && runAhead > 0) {
+    RunAhead();
+  }
+
+  return changed;
+}
+
+inline void GUI::RenderDisplay() {
+  ImGui::Begin("Display", NULL,
+               ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoCollapse |
+                   ImGuiWindowFlags_NoTitleBar);
+
+  ImGui::SetWindowSize(
+      ImVec2(32 + (64 * DISPLAY_SCALE), 48 + (32 * DISPLAY_SCALE)));
+
+  displayFocused = ImGui::IsWindowFocused();
+
+  GLubyte fg[3] = {
+      static_cast<GLubyte>(fgColor.x * 255),
+      static_cast<GLubyte>(fgColor.y * 255),
+      static_cast<GLubyte>(fgColor.z * 255),
+  };
+  GLubyte bg[3] = {
+      static_cast<GLubyte>(bgColor.x * 255),
+      static_cast<GLubyte>(bgColor.y * 255),
+      static_cast<GLubyte>(bgColor.z * 255),
+  };
+
+  // Color changes show up right away, not on the next redraw
+  bool recolor = !palette.Matches(fg, bg);
+  if (recolor) {
+    palette.Set(fg, bg);
+  }
+
+  // Switching the filter changes which texture is shown, fill it in first
+  bool refresh = recolor || phosphorOn != phosphorShown;
+  if (phosphorOn != phosphorShown) {
+    phosphorShown = phosphorOn;
+    phosphor.Clear();
+    fading = false;
+  }
+
+  // The filter's intensities only go through the CPU palette
+  bool shaded = renderer != nullptr && !phosphorOn;
+
+  if (interp->redraw || aheadRedraw || refresh || fading) {
+    // Only the rows sprites touched, unless the whole frame may differ from
+    // the texture. The run-ahead frame comes from a machine that is thrown
+    // away, so nothing is known about it
+    uint32_t rows = interp->dirtyRows;
+    if (runAhead > 0 || refresh) {
+      rows = 0xFFFFFFFF;
+    }
+
     interp->redraw = false;
+    interp->dirtyRows = 0;
+    aheadRedraw = false;
+
+    // With run-ahead on, the future frame is the one on screen
+    auto &display = runAhead > 0 ? aheadDisplay : interp->display;
 
-    GLubyte fg[3] = {
-        static_cast<GLubyte>(fgColor.x * 255),
-        static_cast<GLubyte>(fgColor.y * 255),
-        static_cast<GLubyte>(fgColor.z * 255),
-    };
-    GLubyte bg[3] = {
-        static_cast<GLubyte>(bgColor.x * 255),
-        static_cast<GLubyte>(bgColor.y * 255),
-        static_cast<GLubyte>(bgColor.z * 255),
-    };
+    PackedFrame frame;
+    PackDisplay(display, frame);
+    memcpy(recordFrame, frame, sizeof(frame));
 
     // Draw the display. Scaling is handled by opengl's nearest neighbour
-    for (int i = 0; i < 64 * 32; i++) {
-      auto subpixel = interp->display[i] ? fg : bg;
+    if (phosphorOn) {
+      // Pixels fade everywhere, not just where sprites were drawn
+      phosphor.SetDecay(phosphorDecay);
+      fading = phosphor.Apply(frame);
+      palette.ToRGB(phosphor.Intensity(), displayPixels);
+      rows = 0xFFFFFFFF;
+    } else if (!shaded) {
+      palette.ToRGB(frame, displayPixels);
+    }
 
-      for (int j = 0; j < 3; j++) {
-        displayPixels[i * 3 + j] = subpixel[j];
-      }
+    if (shaded) {
+      // Bits go up as they are, the shader colors and scales them
+      float fgf[3] = {fgColor.x, fgColor.y, fgColor.z};
+      float bgf[3] = {bgColor.x, bgColor.y, bgColor.z};
+      renderer->Upload(frame, rows);
+      renderer->Draw(fgf, bgf);
+    } else if (rows != 0) {
+      // Render the changed span onto the opengl texture. Its storage was
+      // allocated once up front
+      int first = std::countr_zero(rows);
+      int last = 31 - std::countl_zero(rows);
+
+      glBindTexture(GL_TEXTURE_2D, displayTexture);
+      glTexSubImage2D(GL_TEXTURE_2D, 0, 0, first, 64, last - first + 1, GL_RGB,
+                      GL_UNSIGNED_BYTE, displayPixels + first * 64 * 3);
+      glBindTexture(GL_TEXTURE_2D, 0);
     }
+  }
 
-    // Render it onto the opengl texture
-    glBindTexture(GL_TEXTURE_2D, displayTexture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 64, 32, 0, GL_RGB, GL_UNSIGNED_BYTE,
-                 displayPixels);
-    glBindTexture(GL_TEXTURE_2D, 0);
+  if (recording) {
+    Record();
   }
 
-  ImGui::Image((void *)(intptr_t)displayTexture,
+  GLuint texture = shaded ? renderer->Texture() : displayTexture;
+  ImGui::Image((void *)(intptr_t)texture,
                ImVec2(64 * DISPLAY_SCALE, 32 * DISPLAY_SCALE));
   ImGui::End();
 }
 
+inline void GUI::Record() {
+  // One capture per 60Hz tick since the last one, so the video plays at the
+  // speed the game ran even when we draw slower (background, paused). The
+  // frames of a long pause are all alike, dropping some only shortens it
+  auto ticks = (steady_clock::now() - lastCapture) / TIMER_PERIOD;
+  lastCapture += ticks * TIMER_PERIOD;
+
+  for (; ticks > 0; ticks--) {
+    recorder.Capture(recordFrame);
+  }
+}
+
 inline void GUI::RenderGeneral(float framerate) {
   ImGui::Begin("General", NULL, ImGuiWindowFlags_AlwaysAutoResize);
 
@@ -111,16 +309,129 @@ inline void GUI::RenderGeneral(float framerate) {
   ImGui::SameLine();
   ImGui::Text("%d", DISPLAY_SCALE);
 
+  // Netplay runs whole frames at the default clock on both sides and does
+  // its own rollback, these would only get out of step with the remote
+  ImGui::BeginDisabled(netplay != nullptr);
   ImGui::TextColored(labelColor, "Clock:");
   ImGui::SameLine();
   ImGui::InputInt("Hz", &clockSpeed);
+  ImGui::EndDisabled();
+
+  if (netplay != nullptr) {
+    ImGui::TextColored(labelColor, "Netplay:");
+    ImGui::SameLine();
+    ImGui::Text("frame %u, %u stalls", netplay->Frame(), netplay->stalls);
+
+    ImGui::TextColored(labelColor, "Rollbacks:");
+    ImGui::SameLine();
+    ImGui::Text("%u, last %d frames in %.1fus, worst %.1fus",
+                netplay->rollbacks, netplay->lastRollbackFrames,
+                netplay->lastRollbackMicros, netplay->maxRollbackMicros);
+  }
+
+  ImGui::BeginDisabled(netplay != nullptr);
+  ImGui::TextColored(labelColor, "Run-ahead:");
+  ImGui::SameLine();
+  if (ImGui::SliderInt("frames", &runAhead, 0, MAX_RUN_AHEAD)) {
+    // Show the real frame again, or the new future one, right away
+    aheadRedraw = true;
+    if (runAhead > 0) {
+      RunAhead();
+    }
+  }
+  ImGui::EndDisabled();
 
   ImGui::ColorEdit3("FG Color", (float *)&fgColor);
   ImGui::ColorEdit3("BG Color", (float *)&bgColor);
 
+  ImGui::Checkbox("Phosphor", &phosphorOn);
+  if (phosphorOn) {
+    ImGui::SameLine();
+    ImGui::SliderInt("decay", &phosphorDecay, 0, 255);
+  }
+
+  RenderRecorder();
+
+  if (ImGui::CollapsingHeader("Input latency")) {
+    RenderLatency("Key to EX9E/EXA1/FX0A", latency.observeCycles, "cycles");
+    RenderLatency("", latency.observeMicros, "us");
+    RenderLatency("Key to DXYN/00E0", latency.displayCycles, "cycles");
+    RenderLatency("", latency.displayMicros, "us");
+
+    // What the filter adds to every frame before it's uploaded
+    if (phosphorOn) {
+      RenderLatency("Phosphor::Apply", phosphor.applyNanos, "ns");
+    }
+
+    if (ImGui::Button("Reset")) {
+      latency.Reset();
+      phosphor.applyNanos = LatencyHistogram();
+    }
+  }
+
   ImGui::End();
 }
 
+inline void GUI::RenderRecorder() {
+  ImGui::BeginDisabled(recording);
+  ImGui::InputText("file", recordFile, sizeof(recordFile));
+  ImGui::EndDisabled();
+
+  ImGui::SameLine();
+  if (ImGui::Checkbox("Record", &recording)) {
+    if (recording) {
+      RecorderOptions options;
+      options.format = VideoFormatFromName(recordFile);
+      options.backpressure = Backpressure::Drop; // Never stall the frontend
+      options.fg[0] = (uint8_t)(fgColor.x * 255);
+      options.fg[1] = (uint8_t)(fgColor.y * 255);
+      options.fg[2] = (uint8_t)(fgColor.z * 255);
+      options.bg[0] = (uint8_t)(bgColor.x * 255);
+      options.bg[1] = (uint8_t)(bgColor.y * 255);
+      options.bg[2] = (uint8_t)(bgColor.z * 255);
+
+      recording = recorder.Open(recordFile, options);
+      recordFailed = !recording;
+      lastCapture = steady_clock::now();
+    } else {
+      recorder.Close();
+    }
+  }
+
+  if (recordFailed) {
+    ImGui::TextColored(labelColor, "Unable to write to %s", recordFile);
+  } else if (recording || recorder.captured > 0) {
+    ImGui::TextColored(labelColor, "Recorded:");
+    ImGui::SameLine();
+    ImGui::Text("%llu frames, %llu dropped",
+                (unsigned long long)(recorder.captured - recorder.dropped),
+                (unsigned long long)recorder.dropped);
+  }
+}
+
+inline void GUI::RenderLatency(const char *label,
+                               const LatencyHistogram &histogram,
+                               const char *unit) {
+  if (label[0] != 0) {
+    ImGui::TextColored(labelColor, "%s", label);
+  }
+
+  ImGui::Text("n=%llu mean=%.1f max=%llu %s",
+              (unsigned long long)histogram.count, histogram.Mean(),
+              (unsigned long long)histogram.max, unit);
+
+  // Log2 buckets, so the x axis reads 0, 1, 2-3, 4-7, ...
+  float buckets[LATENCY_BUCKETS];
+  for (int i = 0; i < LATENCY_BUCKETS; i++) {
+    buckets[i] = (float)histogram.buckets[i];
+  }
+
+  ImGui::PushID(&histogram);
+  ImGui::PlotHistogram("", buckets, LATENCY_BUCKETS, 0, unit, 0, FLT_MAX,
+                       ImVec2(0, 48));
+  ImGui::PopID();
+}
+
 inline void GUI::RenderCPUState() {
   ImGui::Begin("CPU State", NULL, ImGuiWindowFlags_AlwaysAutoResize);
 
@@ -168,6 +479,8 @@ inline void GUI::RenderDebug() {
   ImGui::TextColored(labelColor, "Status");
   ImGui::Text(clockSpeed == 0 ? "Paused" : "Running");
 
+  // Netplay ignores all of these, see RenderGeneral
+  ImGui::BeginDisabled(netplay != nullptr);
   ImGui::TextColored(labelColor, "Clock");
   if (ImGui::Button(clockSpeed == 0 ? "Resume" : "Pause")) {
     if (clockSpeed == 0) {
@@ -182,6 +495,27 @@ inline void GUI::RenderDebug() {
     tickRequested = true;
   }
 
+  ImGui::TextColored(labelColor, "Breakpoints");
+  ImGui::InputScalar("##breakpoint", ImGuiDataType_U16, &breakpoint, NULL,
+                     NULL, "%03X", ImGuiInputTextFlags_CharsHexadecimal);
+  ImGui::SameLine();
+  if (ImGui::Button("Add")) {
+    control.breakpoints[breakpoint & 0xFFF] = true;
+  }
+
+  ImGui::SameLine();
+  if (ImGui::Button("Clear")) {
+    control.breakpoints.reset();
+  }
+  ImGui::EndDisabled();
+
+  for (int i = 0; i < 4096; i++) {
+    if (control.breakpoints[i]) {
+      ImGui::TextColored(interp->pc == i ? successColor : labelColor, "%03X",
+                         i);
+    }
+  }
+
   ImGui::End();
 }
 
@@ -245,10 +579,56 @@ inline void GUI::RenderStack() {
   ImGui::End();
 }
 
+// FNV-1a over everything the CPU state, stack, keypad and netplay panels
+// show
+inline uint64_t GUI::signature() {
+  uint64_t hash = 0xCBF29CE484222325;
+  auto mix = [&](const void *data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+      hash = (hash ^ ((const uint8_t *)data)[i]) * 0x100000001B3;
+    }
+  };
+
+  mix(interp->reg.data(), sizeof(interp->reg));
+  mix(interp->stack.data(), sizeof(interp->stack));
+  mix(interp->keypadState.data(), sizeof(interp->keypadState));
+  mix(&interp->pc, sizeof(interp->pc));
+  mix(&interp->index, sizeof(interp->index));
+  mix(&interp->opcode, sizeof(interp->opcode));
+  mix(&interp->sp, sizeof(interp->sp));
+  mix(&interp->delayTimer, sizeof(interp->delayTimer));
+  mix(&interp->soundTimer, sizeof(interp->soundTimer));
+  mix(&clockSpeed, sizeof(clockSpeed));
+
+  if (netplay != nullptr) {
+    uint32_t frame = netplay->Frame();
+    mix(&frame, sizeof(frame));
+    mix(&netplay->stalls, sizeof(netplay->stalls));
+    mix(&netplay->rollbacks, sizeof(netplay->rollbacks));
+  }
+
+  return hash;
+}
+
+bool GUI::Changed() {
+  if (interp->redraw || aheadRedraw || fading) {
+    return true;
+  }
+
+  if (kiosk != nullptr) {
+    return false;
+  }
+
+  return interp->dirtyPages != 0 || signature() != shown;
+}
+
 void GUI::Render() {
   auto framerate = ImGui::GetIO().Framerate;
 
-  RenderDisplay(framerate);
+  shown = signature();
+  interp->dirtyPages = 0;
+
+  RenderDisplay();
   RenderGeneral(framerate);
   RenderCPUState();
   RenderDebug();
@@ -256,4 +636,58 @@ void GUI::Render() {
   RenderKeypadState();
   RenderStack();
 }
+
+void GUI::Present(int width, int height) {
+  float fg[3] = {fgColor.x, fgColor.y, fgColor.z};
+  float bg[3] = {bgColor.x, bgColor.y, bgColor.z};
+
+  if (interp->redraw || aheadRedraw) {
+    uint32_t rows = runAhead > 0 ? 0xFFFFFFFF : interp->dirtyRows;
+    auto &display = runAhead > 0 ? aheadDisplay : interp->display;
+
+    interp->redraw = false;
+    interp->dirtyRows = 0;
+    aheadRedraw = false;
+
+    PackedFrame frame;
+    PackDisplay(display, frame);
+    renderer->Upload(frame, rows);
+  }
+
+  // Largest whole multiple of 64x32 that fits, centered. Whatever is left
+  // over gets the background color
+  int scale = std::max(1, std::min(width / 64, height / 32));
+  int w = 64 * scale;
+  int h = 32 * scale;
+
+  glViewport(0, 0, width, height);
+  glClearColor(bg[0], bg[1], bg[2], 1);
+  glClear(GL_COLOR_BUFFER_BIT);
+
+  renderer->Present((width - w) / 2, (height - h) / 2, w, h, fg, bg);
+}
+
+bool GUI::Idle() {
+  return netplay == nullptr && (clockSpeed == 0 || interp->waitingForKey);
+}
+
+double GUI::IdleTimeout(bool background) {
+  if (tickRequested) {
+    return 0;
+  }
+
+  if (!Idle()) {
+    // Still emulating, but nobody is looking closely. Update at a lower rate
+    return background ? BACKGROUND_FRAME_TIME : 0;
+  }
+
+  // Paused or parked on FX0A. Any input event wakes us up, so we only need
+  // to come back on our own to keep the timers counting down
+  if (interp->delayTimer > 0 || interp->soundTimer > 0) {
+    auto next = lastTimer + TIMER_PERIOD - steady_clock::now();
+    return std::max(std::chrono::duration<double>(next).count(), 0.001);
+  }
+
+  return 0.5;
+}
 } // namespace chip8
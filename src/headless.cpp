@@ -0,0 +1,343 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdlib.h>
+#include <string>
+#include <time.h>
+#include <vector>
+
+#include "chip8.hpp"
+#include "input_script.hpp"
+#include "latency.hpp"
+#include "palette.hpp"
+#include "phosphor.hpp"
+#include "recorder.hpp"
+#include "upscale.hpp"
+
+// Runs a program without a window: no GLFW, no OpenGL, no ImGui. Meant for
+// display-less hosts, scripted regression runs and latency measurements
+
+static void usage(const char *argv0) {
+  std::cerr
+      << "Usage:" << std::endl
+      << argv0 << " [options] path/to/chip8/program" << std::endl
+      << std::endl
+      << "  --frames n      Stop after n 60Hz frames (default 600)" << std::endl
+      << "  --cycles n      Stop after n instructions" << std::endl
+      << "  --clock hz      Instructions per second (default 960)" << std::endl
+      << "  --seed n        Seed for CXNN (default: time)" << std::endl
+      << "  --input file    Scripted keypad input, see input_script.hpp"
+      << std::endl
+      << "  --out dir       Write the final state and frame to dir" << std::endl
+      << "  --dump-frames   Also write every frame that changed to dir"
+      << std::endl
+      << "  --color         Dump frames as PPM in the frontend's colors"
+      << std::endl
+      << "  --phosphor n    Dump frames with afterglow, n/256 kept per frame"
+      << std::endl
+      << "                  (implies --color, 176 is a good start)" << std::endl
+      << "  --scale n       Upscale dumped frames n times, nearest neighbour,"
+      << std::endl
+      << "                  or 2x/3x for Scale2x/Scale3x (implies --color)"
+      << std::endl
+      << "  --latency file  Write input latency histograms as CSV, plus the"
+      << std::endl
+      << "                  phosphor filter's time per frame with --phosphor"
+      << std::endl
+      << "  --record file   Record every frame, .y4m, .gif or raw RGB24"
+      << std::endl
+      << "                  (--scale n applies, --phosphor doesn't mix)"
+      << std::endl
+      << "  --record-drop   Drop frames when the encoder falls behind instead"
+      << std::endl
+      << "                  of waiting for it" << std::endl;
+}
+
+// 64x32 binary PBM, one bit per pixel
+static bool writeFrame(const std::string &filename, const chip8::Chip8 &c8) {
+  std::ofstream ofile(filename, std::ios::binary);
+  if (!ofile) {
+    return false;
+  }
+
+  ofile << "P4\n64 32\n";
+  for (int i = 0; i < 64 * 32; i += 8) {
+    char b = 0;
+    for (int j = 0; j < 8; j++) {
+      b |= c8.display[i + j] << (7 - j);
+    }
+
+    ofile.put(b);
+  }
+
+  return true;
+}
+
+// Binary PPM
+static bool writeColorFrame(const std::string &filename, const uint8_t *rgb,
+                            int width, int height) {
+  std::ofstream ofile(filename, std::ios::binary);
+  if (!ofile) {
+    return false;
+  }
+
+  ofile << "P6\n" << width << " " << height << "\n255\n";
+  ofile.write((const char *)rgb, (size_t)width * height * 3);
+  return true;
+}
+
+static bool writeState(const std::string &dir, const chip8::Chip8 &c8,
+                       uint64_t frames) {
+  std::ofstream state(dir + "/state.txt");
+  if (!state) {
+    return false;
+  }
+
+  state << std::hex << std::uppercase << std::setfill('0');
+  state << "PC " << std::setw(4) << c8.pc << "\n";
+  state << "I  " << std::setw(4) << c8.index << "\n";
+  state << "OP " << std::setw(4) << c8.opcode << "\n";
+  for (int i = 0; i < 16; i++) {
+    state << "V" << i << " " << std::setw(2) << (int)c8.reg[i] << "\n";
+  }
+
+  state << "DT " << std::setw(2) << (int)c8.delayTimer << "\n";
+  state << "ST " << std::setw(2) << (int)c8.soundTimer << "\n";
+  state << "SP " << std::setw(2) << (int)c8.sp << "\n";
+  for (int i = 0; i < 16; i++) {
+    state << "S" << i << " " << std::setw(4) << c8.stack[i] << "\n";
+  }
+
+  state << std::dec;
+  state << "cycles " << c8.cycles << "\n";
+  state << "frames " << frames << "\n";
+
+  std::ofstream mem(dir + "/memory.bin", std::ios::binary);
+  mem.write((const char *)c8.mem.data(), c8.mem.size());
+
+  return mem && writeFrame(dir + "/final.pbm", c8);
+}
+
+int main(int args, char **argv) {
+  const char *program = NULL;
+  const char *inputFile = NULL;
+  const char *outDir = NULL;
+  const char *latencyFile = NULL;
+  const char *recordFile = NULL;
+  uint64_t maxFrames = 600;
+  uint64_t maxCycles = 0;
+  int clockSpeed = 960;
+  uint32_t seed = (uint32_t)time(NULL);
+  bool dumpFrames = false;
+  bool color = false;
+  int decay = -1; // Phosphor filter off
+  int scale = 1;   // Nearest neighbour
+  int epx = 0;     // 2 or 3 for Scale2x/Scale3x instead
+  chip8::RecorderOptions recordOptions;
+  recordOptions.backpressure = chip8::Backpressure::Block; // No deadline here
+
+  for (int i = 1; i < args; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < args;
+
+    if (arg == "--frames" && hasValue) {
+      maxFrames = strtoull(argv[++i], NULL, 0);
+    } else if (arg == "--cycles" && hasValue) {
+      maxCycles = strtoull(argv[++i], NULL, 0);
+      maxFrames = 0;
+    } else if (arg == "--clock" && hasValue) {
+      clockSpeed = atoi(argv[++i]);
+    } else if (arg == "--seed" && hasValue) {
+      seed = strtoul(argv[++i], NULL, 0);
+    } else if (arg == "--input" && hasValue) {
+      inputFile = argv[++i];
+    } else if (arg == "--out" && hasValue) {
+      outDir = argv[++i];
+    } else if (arg == "--dump-frames") {
+      dumpFrames = true;
+    } else if (arg == "--color") {
+      color = true;
+    } else if (arg == "--phosphor" && hasValue) {
+      decay = std::clamp(atoi(argv[++i]), 0, 255);
+      color = true;
+    } else if (arg == "--scale" && hasValue) {
+      std::string value = argv[++i];
+      if (value == "2x" || value == "3x") {
+        epx = value[0] - '0';
+      } else {
+        scale = std::clamp(atoi(value.c_str()), 1, 16);
+      }
+      color = true;
+    } else if (arg == "--latency" && hasValue) {
+      latencyFile = argv[++i];
+    } else if (arg == "--record" && hasValue) {
+      recordFile = argv[++i];
+    } else if (arg == "--record-drop") {
+      recordOptions.backpressure = chip8::Backpressure::Drop;
+    } else if (arg[0] == '-') {
+      usage(argv[0]);
+      return 1;
+    } else {
+      program = argv[i];
+    }
+  }
+
+  // Scale2x and Scale3x look at lit or unlit pixels, the afterglow has shades,
+  // and they don't chain with nearest neighbour. Recordings have two colors,
+  // so no afterglow there either. A stopped clock never reaches --cycles
+  if (program == NULL || (dumpFrames && outDir == NULL) ||
+      (epx != 0 && (decay >= 0 || scale > 1)) ||
+      (recordFile != NULL && decay >= 0) ||
+      (maxCycles != 0 && clockSpeed <= 0)) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  chip8::Chip8 interp;
+  interp.Reset();
+  interp.Seed(seed);
+
+  if (!interp.LoadProgram(program)) {
+    std::cerr << "Unable to load " << program << std::endl;
+    return -1;
+  }
+
+  chip8::InputScript script;
+  if (inputFile != NULL && !script.Load(inputFile)) {
+    std::cerr << "Unable to load " << inputFile << std::endl;
+    return -1;
+  }
+
+  chip8::LatencyProbe probe;
+  if (latencyFile != NULL) {
+    interp.probe = &probe;
+  }
+
+  chip8::Recorder recorder;
+  if (recordFile != NULL) {
+    recordOptions.format = chip8::VideoFormatFromName(recordFile);
+    recordOptions.scale = scale;
+
+    if (!recorder.Open(recordFile, recordOptions)) {
+      std::cerr << "Unable to write to " << recordFile << std::endl;
+      return -1;
+    }
+  }
+
+  chip8::Palette palette;
+  chip8::Phosphor phosphor(decay >= 0 ? decay : PHOSPHOR_DECAY);
+  uint8_t rgb[PALETTE_RGB_SIZE];
+
+  // Upscaled frames, allocated once
+  int width = 64 * scale * std::max(epx, 1);
+  int height = 32 * scale * std::max(epx, 1);
+  std::vector<uint64_t> bits(epx * epx * OBSERVATION_HEIGHT);
+  std::vector<uint8_t> scaled(scale > 1 || epx != 0 ? width * height * 3 : 0);
+
+  // Clocks that aren't a multiple of 60 carry the fraction over, like the
+  // frontend does, so --clock 30 runs a cycle every other frame
+  double cycleBudget = 0;
+  size_t cursor = 0;
+  uint64_t frame = 0;
+
+  while ((maxFrames == 0 || frame < maxFrames) &&
+         (maxCycles == 0 || interp.cycles < maxCycles)) {
+    cursor = script.Apply(interp, frame, cursor);
+
+    cycleBudget += std::max(clockSpeed, 0) / 60.0;
+    int cycles = (int)cycleBudget;
+    cycleBudget -= cycles;
+
+    if (maxCycles != 0 && interp.cycles + cycles > maxCycles) {
+      cycles = maxCycles - interp.cycles;
+    }
+
+    interp.RunFrame(cycles);
+    frame++;
+
+    if (recordFile != NULL) {
+      recorder.Capture(interp);
+    }
+
+    // The afterglow changes frames that didn't change otherwise
+    bool fading = false;
+    if (dumpFrames && decay >= 0) {
+      chip8::PackedFrame packed;
+      chip8::PackDisplay(interp, packed);
+      fading = phosphor.Apply(packed);
+    }
+
+    if (dumpFrames && (interp.redraw || fading)) {
+      interp.redraw = false;
+
+      char name[32];
+      snprintf(name, sizeof(name), "/frame_%06llu.%s",
+               (unsigned long long)frame, color ? "ppm" : "pbm");
+
+      if (color) {
+        chip8::PackedFrame packed;
+        chip8::PackDisplay(interp, packed);
+        const uint8_t *pixels = rgb;
+
+        if (decay >= 0) {
+          palette.ToRGB(phosphor.Intensity(), rgb);
+        } else if (epx != 0) {
+          if (epx == 2) {
+            chip8::Scale2x(packed, 1, OBSERVATION_HEIGHT, bits.data());
+          } else {
+            chip8::Scale3x(packed, 1, OBSERVATION_HEIGHT, bits.data());
+          }
+
+          palette.ToRGB(bits.data(), (int)bits.size(), scaled.data());
+          pixels = scaled.data();
+        } else {
+          palette.ToRGB(packed, rgb);
+        }
+
+        if (scale > 1) {
+          chip8::ScaleNearest(rgb, 64, 32, scale, scaled.data());
+          pixels = scaled.data();
+        }
+
+        writeColorFrame(outDir + std::string(name), pixels, width, height);
+      } else {
+        writeFrame(outDir + std::string(name), interp);
+      }
+    }
+  }
+
+  if (outDir != NULL && !writeState(outDir, interp, frame)) {
+    std::cerr << "Unable to write to " << outDir << std::endl;
+    return -1;
+  }
+
+  if (recordFile != NULL) {
+    recorder.Close();
+    std::cout << "Recorded " << recorder.captured - recorder.dropped
+              << " frames, " << recorder.dropped << " dropped, "
+              << recorder.blocked << " waited for the encoder" << std::endl;
+  }
+
+  if (latencyFile != NULL) {
+    std::ofstream ofile(latencyFile);
+    probe.WriteCSV(ofile);
+
+    if (dumpFrames && decay >= 0) {
+      phosphor.applyNanos.WriteCSV(ofile, "phosphor_apply_ns");
+    }
+  }
+
+  std::cout << "Ran " << interp.cycles << " cycles in " << frame << " frames, "
+            << "PC " << std::hex << std::uppercase << interp.pc << std::endl;
+
+  // Only --record-drop may lose frames
+  if (recordFile != NULL && recorder.dropped > 0 &&
+      recordOptions.backpressure != chip8::Backpressure::Drop) {
+    return -1;
+  }
+
+  return 0;
+}
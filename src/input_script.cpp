@@ -0,0 +1,74 @@
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "input_script.hpp"
+
+namespace chip8 {
+bool InputScript::Load(const std::string &filename) {
+  std::ifstream ifile(filename);
+
+  if (!ifile) {
+    return false;
+  }
+
+  events.clear();
+
+  std::string line;
+  int lineNumber = 0;
+  while (std::getline(ifile, line)) {
+    lineNumber++;
+
+    auto comment = line.find('#');
+    if (comment != std::string::npos) {
+      line.erase(comment);
+    }
+
+    std::istringstream fields(line);
+    uint64_t frame;
+    std::string key, state;
+    if (!(fields >> frame)) {
+      continue; // Blank line
+    }
+
+    if (!(fields >> key >> state) || key.size() != 1 ||
+        !std::isxdigit((unsigned char)key[0])) {
+      std::cerr << filename << ":" << lineNumber
+                << ": expected 'frame key state'" << std::endl;
+      return false;
+    }
+
+    bool down = state == "down" || state == "1";
+    if (!down && state != "up" && state != "0") {
+      std::cerr << filename << ":" << lineNumber << ": unknown state '"
+                << state << "', expected down/up or 1/0" << std::endl;
+      return false;
+    }
+
+    Event event;
+    event.frame = frame;
+    event.key = std::stoi(key, nullptr, 16);
+    event.down = down;
+    events.push_back(event);
+  }
+
+  // Keep the order of events within the same frame
+  std::stable_sort(events.begin(), events.end(),
+                   [](const Event &a, const Event &b) {
+                     return a.frame < b.frame;
+                   });
+
+  return true;
+}
+
+size_t InputScript::Apply(Chip8 &c8, uint64_t frame, size_t cursor) const {
+  for (; cursor < events.size() && events[cursor].frame <= frame; cursor++) {
+    c8.SetKey(events[cursor].key, events[cursor].down);
+  }
+
+  return cursor;
+}
+} // namespace chip8
@@ -0,0 +1,110 @@
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+#include "latency.hpp"
+
+using std::chrono::steady_clock;
+
+namespace chip8 {
+void LatencyHistogram::Add(uint64_t value) {
+  int bucket = 0;
+  while (bucket < LATENCY_BUCKETS - 1 && value >= (1ull << bucket)) {
+    bucket++;
+  }
+
+  buckets[bucket]++;
+  count++;
+  sum += value;
+  if (value > max) {
+    max = value;
+  }
+}
+
+double LatencyHistogram::Mean() const {
+  return count > 0 ? (double)sum / count : 0;
+}
+
+static uint64_t micros(steady_clock::time_point since) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             steady_clock::now() - since)
+      .count();
+}
+
+void LatencyProbe::KeyEvent(uint8_t key, uint64_t cycle) {
+  auto &event = pending[key];
+
+  // A newer event on the same key replaces one still waiting for a redraw
+  if (event.active && event.observed) {
+    awaitingDisplay--;
+  }
+
+  event.active = true;
+  event.observed = false;
+  event.cycle = cycle;
+  event.time = steady_clock::now();
+}
+
+void LatencyProbe::KeyObserved(uint8_t key, uint64_t cycle) {
+  auto &event = pending[key];
+  if (!event.active || event.observed) {
+    return;
+  }
+
+  event.observed = true;
+  awaitingDisplay++;
+
+  observeCycles.Add(cycle - event.cycle);
+  observeMicros.Add(micros(event.time));
+}
+
+void LatencyProbe::DisplayChanged(uint64_t cycle) {
+  if (awaitingDisplay == 0) {
+    return;
+  }
+
+  for (auto &event : pending) {
+    if (event.active && event.observed) {
+      displayCycles.Add(cycle - event.cycle);
+      displayMicros.Add(micros(event.time));
+      event.active = false;
+    }
+  }
+
+  awaitingDisplay = 0;
+}
+
+void LatencyProbe::Rewind(uint64_t cycle) {
+  for (auto &event : pending) {
+    if (event.active && event.cycle > cycle) {
+      if (event.observed) {
+        awaitingDisplay--;
+      }
+
+      event.active = false;
+    }
+  }
+}
+
+void LatencyProbe::Reset() { *this = LatencyProbe(); }
+
+void LatencyHistogram::WriteCSV(std::ostream &out, const char *metric) const {
+  for (int b = 0; b < LATENCY_BUCKETS; b++) {
+    uint64_t low = b == 0 ? 0 : 1ull << (b - 1);
+    uint64_t high = b == 0 ? 0 : (1ull << b) - 1;
+    out << metric << "," << low << "," << high << "," << buckets[b] << "\n";
+  }
+
+  out << metric << "_count,,," << count << "\n";
+  out << metric << "_mean,,," << Mean() << "\n";
+  out << metric << "_max,,," << max << "\n";
+}
+
+void LatencyProbe::WriteCSV(std::ostream &out) const {
+  out << "metric,bucket_low,bucket_high,count\n";
+  observeCycles.WriteCSV(out, "observe_cycles");
+  observeMicros.WriteCSV(out, "observe_us");
+  displayCycles.WriteCSV(out, "display_cycles");
+  displayMicros.WriteCSV(out, "display_us");
+}
+} // namespace chip8
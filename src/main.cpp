@@ -7,13 +7,20 @@
 #include <GLES2/gl2.h>
 #endif
 
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <memory>
 #include <stdlib.h>
+#include <string>
 #include <time.h>
 
 #include "chip8.hpp"
+#include "display_renderer.hpp"
 #include "font.h"
 #include "gui.hpp"
+#include "mosaic.hpp"
+#include "netplay.hpp"
 
 // Ummmm
 #if defined(_MSC_VER) && (_MSC_VER >= 1900) &&                                 \
@@ -25,14 +32,205 @@ static void glfw_error_callback(int error, const char *description) {
   std::cerr << "GLFW Error " << error << ": " << description << std::endl;
 }
 
+// Frames left to render after the last input event. ImGui needs a couple of
+// frames to settle hover and click states, even when the interpreter is idle
+static int inputFrames = 0;
+
+// Track input on the main window. ImGui chains to these, so they have to be
+// installed before ImGui_ImplGlfw_InitForOpenGL
+static void install_input_callbacks(GLFWwindow *window) {
+  glfwSetKeyCallback(window, [](GLFWwindow *, int, int, int, int) {
+    inputFrames = 3;
+  });
+  glfwSetCharCallback(window, [](GLFWwindow *, unsigned int) {
+    inputFrames = 3;
+  });
+  glfwSetMouseButtonCallback(window, [](GLFWwindow *, int, int, int) {
+    inputFrames = 3;
+  });
+  glfwSetCursorPosCallback(window, [](GLFWwindow *, double, double) {
+    inputFrames = 3;
+  });
+  glfwSetScrollCallback(window, [](GLFWwindow *, double, double) {
+    inputFrames = 3;
+  });
+  glfwSetWindowFocusCallback(window, [](GLFWwindow *, int) {
+    inputFrames = 3;
+  });
+  glfwSetWindowSizeCallback(window, [](GLFWwindow *, int, int) {
+    inputFrames = 3;
+  });
+  glfwSetWindowRefreshCallback(window, [](GLFWwindow *) {
+    inputFrames = 3;
+  });
+}
+
+// The debugger UI. Kiosk mode goes without, ImGui is never even set up
+static void init_imgui(GLFWwindow *window, const char *glsl_version) {
+  IMGUI_CHECKVERSION();
+  ImGui::CreateContext();
+  ImGuiIO &io = ImGui::GetIO();
+  (void)io;
+
+  io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;
+  io.ConfigFlags |= ImGuiConfigFlags_DockingEnable;
+  io.ConfigFlags |= ImGuiConfigFlags_ViewportsEnable;
+
+  // Setup Dear ImGui style
+  ImGui::StyleColorsDark();
+
+  auto &style = ImGui::GetStyle();
+  style.FrameRounding = 2;
+  // style.FramePadding = ImVec2(2, 1);
+  style.WindowRounding = 4;
+  style.WindowPadding = ImVec2(16, 12);
+  style.Colors[ImGuiCol_WindowBg] =
+      ImVec4(0.094f, 0.094f, 0.101f, 1); // ~#18181A
+
+  ImFont *font = io.Fonts->AddFontFromMemoryCompressedTTF(
+      jetbrains_mono_compressed_data, jetbrains_mono_compressed_size, 18);
+  io.Fonts->Build();
+  ImGui::SetCurrentFont(font);
+
+  // Setup Platform/Renderer backends
+  ImGui_ImplGlfw_InitForOpenGL(window, true);
+  ImGui_ImplOpenGL3_Init(glsl_version);
+}
+
+// Cells across for count displays in a window, so that they come out as
+// large as possible
+static int mosaic_columns(int count, int width, int height) {
+  int best = 1;
+  float bestScale = 0;
+
+  for (int columns = 1; columns <= count; columns++) {
+    int rows = (count + columns - 1) / columns;
+    float scale = std::min(width / (64.0f * columns), height / (32.0f * rows));
+    if (scale > bestScale) {
+      best = columns;
+      bestScale = scale;
+    }
+  }
+
+  return best;
+}
+
+// Many seeds of one program in a grid, drawn from one atlas texture. No
+// ImGui and no input, it's for watching
+static int run_mosaic(GLFWwindow *window, const char *glsl_version,
+                      const char *program, int instances, uint32_t seed,
+                      const char *input) {
+  chip8::Mosaic mosaic;
+  if (!mosaic.Load(program, instances, seed, input != NULL ? input : "")) {
+    std::cerr << "Unable to load " << program << std::endl;
+    return -1;
+  }
+
+  int display_w, display_h;
+  glfwGetFramebufferSize(window, &display_w, &display_h);
+
+  int columns = mosaic_columns(instances, display_w, display_h);
+  int rows = (instances + columns - 1) / columns;
+
+  chip8::DisplayRenderer renderer;
+  if (!renderer.Init(glsl_version, 64, 32, columns, rows)) {
+    std::cerr << "The mosaic needs GLSL 1.30" << std::endl;
+    return -1;
+  }
+
+  float fg[3] = {0.0f, 1.0f, 0.611f};
+  float bg[3] = {0.047f, 0.047f, 0.047f};
+
+  renderer.UploadAtlas(mosaic.Frames(), instances);
+  auto lastFrame = std::chrono::steady_clock::now();
+
+  while (!glfwWindowShouldClose(window)) {
+    glfwPollEvents();
+
+    // Whole 60Hz frames, anything more than a few behind is dropped
+    auto now = std::chrono::steady_clock::now();
+    auto frames = (now - lastFrame) / TIMER_PERIOD;
+    lastFrame += frames * TIMER_PERIOD;
+
+    bool changed = false;
+    for (frames = std::min<long long>(frames, 4); frames > 0; frames--) {
+      changed = mosaic.RunFrame() || changed;
+    }
+
+    if (changed) {
+      renderer.UploadAtlas(mosaic.Frames(), instances);
+    }
+
+    // Whole multiples when the grid fits, shrunk to fit otherwise
+    glfwGetFramebufferSize(window, &display_w, &display_h);
+    float scale = std::min(display_w / (64.0f * columns),
+                           display_h / (32.0f * rows));
+    if (scale >= 1) {
+      scale = (int)scale;
+    }
+
+    int w = 64 * columns * scale;
+    int h = 32 * rows * scale;
+
+    glViewport(0, 0, display_w, display_h);
+    glClearColor(bg[0], bg[1], bg[2], 1);
+    glClear(GL_COLOR_BUFFER_BIT);
+    renderer.Present((display_w - w) / 2, (display_h - h) / 2, w, h, fg, bg);
+
+    glfwSwapBuffers(window);
+  }
+
+  return 0;
+}
+
 int main(int args, char **argv) {
-  if (args < 2) {
+  const char *program = NULL;
+  const char *netplayHost = NULL;
+  int netplayLocalPort = 0;
+  int netplayRemotePort = 0;
+  uint32_t seed = 0;
+  bool seeded = false;
+  bool kiosk = false;
+  int mosaic = 0;
+  const char *input = NULL;
+
+  for (int i = 1; i < args; i++) {
+    std::string arg = argv[i];
+
+    if (arg == "--netplay" && i + 3 < args) {
+      netplayLocalPort = atoi(argv[++i]);
+      netplayHost = argv[++i];
+      netplayRemotePort = atoi(argv[++i]);
+    } else if (arg == "--kiosk") {
+      kiosk = true;
+    } else if (arg == "--mosaic" && i + 1 < args) {
+      mosaic = atoi(argv[++i]);
+    } else if (arg == "--input" && i + 1 < args) {
+      input = argv[++i];
+    } else if (arg == "--seed" && i + 1 < args) {
+      seed = strtoul(argv[++i], NULL, 0);
+      seeded = true;
+    } else {
+      program = argv[i];
+    }
+  }
+
+  if (program == NULL) {
     std::cerr << "Usage:" << std::endl
-              << argv[0] << " path/to/chip8/program" << std::endl;
+              << argv[0]
+              << " [--netplay local-port remote-host remote-port]"
+                 " [--seed n] [--kiosk]"
+                 " [--mosaic instances [--input script]]"
+                 " path/to/chip8/program"
+              << std::endl;
     return 1;
   }
 
-  srand((unsigned)time(NULL));
+  // Both netplay sides have to roll the same random numbers, so they share a
+  // fixed seed unless one is given
+  if (!seeded && netplayHost == NULL) {
+    seed = (uint32_t)time(NULL);
+  }
 
   // Setup window
   glfwSetErrorCallback(glfw_error_callback);
@@ -67,14 +265,14 @@ int main(int args, char **argv) {
   glfwMakeContextCurrent(window);
   glfwSwapInterval(1); // Enable vsync
 
-  IMGUI_CHECKVERSION();
-  ImGui::CreateContext();
-  ImGuiIO &io = ImGui::GetIO();
-  (void)io;
+  install_input_callbacks(window);
 
-  io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;
-  io.ConfigFlags |= ImGuiConfigFlags_DockingEnable;
-  io.ConfigFlags |= ImGuiConfigFlags_ViewportsEnable;
+  if (mosaic > 0) {
+    int status = run_mosaic(window, glsl_version, program, mosaic, seed, input);
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return status;
+  }
 
   GLubyte displayPixels[64 * 32 * 3];
 
@@ -92,56 +290,136 @@ int main(int args, char **argv) {
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
   glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
 
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 64, 32, 0, GL_RGB, GL_UNSIGNED_BYTE,
-               displayPixels);
-
-  // Setup Dear ImGui style
-  ImGui::StyleColorsDark();
-
-  auto &style = ImGui::GetStyle();
-  style.FrameRounding = 2;
-  // style.FramePadding = ImVec2(2, 1);
-  style.WindowRounding = 4;
-  style.WindowPadding = ImVec2(16, 12);
-  style.Colors[ImGuiCol_WindowBg] =
-      ImVec4(0.094f, 0.094f, 0.101f, 1); // ~#18181A
+  // Storage is allocated once, redraws only update the rows that changed.
+  // Immutable storage where the driver has it (GL 4.2+, not macOS)
+  using TexStorage2D = void(APIENTRY *)(GLenum, GLsizei, GLenum, GLsizei,
+                                        GLsizei);
+  auto texStorage2D = (TexStorage2D)glfwGetProcAddress("glTexStorage2D");
+
+  if (texStorage2D != NULL) {
+    texStorage2D(GL_TEXTURE_2D, 1, GL_RGB8, 64, 32);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 64, 32, GL_RGB, GL_UNSIGNED_BYTE,
+                    displayPixels);
+  } else {
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 64, 32, 0, GL_RGB,
+                 GL_UNSIGNED_BYTE, displayPixels);
+  }
 
-  ImFont *font = io.Fonts->AddFontFromMemoryCompressedTTF(
-      jetbrains_mono_compressed_data, jetbrains_mono_compressed_size, 18);
-  io.Fonts->Build();
-  ImGui::SetCurrentFont(font);
+  // Palette and scaling in a shader where GLSL is new enough. The texture
+  // above stays as the fallback
+  chip8::DisplayRenderer renderer;
+  bool shaded =
+      renderer.Init(glsl_version, 64 * DISPLAY_SCALE, 32 * DISPLAY_SCALE);
+
+  // Kiosk mode draws through the shader, without it there is only the UI
+  if (kiosk && !shaded) {
+    std::cerr << "Kiosk mode needs GLSL 1.30, showing the debugger"
+              << std::endl;
+    kiosk = false;
+  }
 
-  // Setup Platform/Renderer backends
-  ImGui_ImplGlfw_InitForOpenGL(window, true);
-  ImGui_ImplOpenGL3_Init(glsl_version);
+  if (!kiosk) {
+    init_imgui(window, glsl_version);
+  }
 
   // Our state
   auto clear_color = ImVec4(0.024f, 0.024f, 0.03f, 1.00f);
 
   chip8::Chip8 interp;
   interp.Reset();
+  interp.Seed(seed);
 
-  if (!interp.LoadProgram(argv[1])) {
-    std::cerr << "Unable to load " << argv[1] << std::endl;
+  if (!interp.LoadProgram(program)) {
+    std::cerr << "Unable to load " << program << std::endl;
     return -1;
   }
 
-  chip8::GUI gui(&interp, displayTexture, displayPixels);
+  // Netplay runs the default 960Hz clock, both sides must agree on it
+  std::unique_ptr<chip8::Netplay> netplay;
+  if (netplayHost != NULL) {
+    netplay = std::make_unique<chip8::Netplay>(&interp, 960 / 60);
+    if (!netplay->Connect(netplayLocalPort, netplayHost, netplayRemotePort)) {
+      return -1;
+    }
+  }
+
+  chip8::GUI gui(&interp, displayTexture, displayPixels, netplay.get(),
+                 shaded ? &renderer : nullptr);
+
+  if (kiosk) {
+    gui.kiosk = window;
+  }
+
+  // Last time around built no frame, so there was no vsync to wait on
+  bool skipped = false;
 
   while (!glfwWindowShouldClose(window)) {
-    glfwPollEvents();
+    bool iconified = glfwGetWindowAttrib(window, GLFW_ICONIFIED);
+    bool background = iconified || !glfwGetWindowAttrib(window, GLFW_FOCUSED);
+
+    // Block on events while the interpreter is paused, parked on FX0A or in
+    // the background
+    auto timeout = gui.IdleTimeout(background);
+    if (timeout == 0 && skipped) {
+      timeout = 1.0 / 60;
+    }
+
+    if (timeout > 0) {
+      glfwWaitEventsTimeout(timeout);
+    } else {
+      glfwPollEvents();
+    }
+
+    // Panels dragged out into their own windows get their input through
+    // ImGui's callbacks, not ours. Never skip while any are open
+    bool viewports = !kiosk && ImGui::GetPlatformIO().Viewports.Size > 1;
+
+    // Keep emulating without building a frame when nothing can be seen, or
+    // when nothing on screen would change and nobody touched the window.
+    // Update runs once either way: up front when the frame may be skipped,
+    // inside the ImGui frame otherwise. Input always builds frames, so up
+    // front the keys can't have changed and aren't read
+    bool build = !iconified && (inputFrames > 0 || viewports);
+    if (!build) {
+      gui.Update(kiosk);
+      skipped = iconified || !gui.Changed();
+      if (skipped) {
+        continue;
+      }
+    }
+
+    skipped = false;
+
+    if (inputFrames > 0) {
+      inputFrames--;
+    }
+
+    int display_w, display_h;
+    glfwGetFramebufferSize(window, &display_w, &display_h);
+
+    if (kiosk) {
+      if (build) {
+        gui.Update();
+      }
+
+      gui.Present(display_w, display_h);
+      glfwSwapBuffers(window);
+      continue;
+    }
 
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
 
+    if (build) {
+      gui.Update();
+    }
+
     gui.Render();
 
     // Rendering
     ImGui::Render();
 
-    int display_w, display_h;
-    glfwGetFramebufferSize(window, &display_w, &display_h);
     glViewport(0, 0, display_w, display_h);
     glClearColor(clear_color.x * clear_color.w, clear_color.y * clear_color.w,
                  clear_color.z * clear_color.w, clear_color.w);
@@ -149,7 +427,7 @@ int main(int args, char **argv) {
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
     // Update and Render additional Platform Windows
-    if (io.ConfigFlags & ImGuiConfigFlags_ViewportsEnable) {
+    if (ImGui::GetIO().ConfigFlags & ImGuiConfigFlags_ViewportsEnable) {
       GLFWwindow *backup_current_context = glfwGetCurrentContext();
       ImGui::UpdatePlatformWindows();
       ImGui::RenderPlatformWindowsDefault();
@@ -160,9 +438,11 @@ int main(int args, char **argv) {
   }
 
   // Cleanup
-  ImGui_ImplOpenGL3_Shutdown();
-  ImGui_ImplGlfw_Shutdown();
-  ImGui::DestroyContext();
+  if (!kiosk) {
+    ImGui_ImplOpenGL3_Shutdown();
+    ImGui_ImplGlfw_Shutdown();
+    ImGui::DestroyContext();
+  }
 
   glfwDestroyWindow(window);
   glfwTerminate();
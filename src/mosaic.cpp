@@ -0,0 +1,74 @@
+#include <algorithm>
+#include <atomic>
+
+#include "mosaic.hpp"
+
+namespace chip8 {
+Mosaic::Mosaic(int threads, int cyclesPerFrame)
+    : pool(threads), cyclesPerFrame(cyclesPerFrame) {}
+
+bool Mosaic::Load(const std::string &rom, int instances, uint32_t firstSeed,
+                  const std::string &input) {
+  script = InputScript();
+  if (!input.empty() && !script.Load(input)) {
+    return false;
+  }
+
+  Chip8 c8;
+  c8.Reset();
+  if (!c8.LoadProgram(rom)) {
+    return false;
+  }
+
+  machines.assign(instances, c8);
+  for (int i = 0; i < instances; i++) {
+    machines[i].Seed(firstSeed + i);
+  }
+
+  cursors.assign(instances, 0);
+  frames.assign((size_t)instances * OBSERVATION_HEIGHT, 0);
+  frame = 0;
+
+  for (int i = 0; i < instances; i++) {
+    PackDisplay(machines[i], &frames[i * OBSERVATION_HEIGHT]);
+  }
+
+  return true;
+}
+
+bool Mosaic::RunFrame() {
+  std::atomic<bool> changed = false;
+  int instances = Instances();
+
+  for (int first = 0; first < instances; first += MOSAIC_CHUNK) {
+    int last = std::min(first + MOSAIC_CHUNK, instances);
+
+    pool.Submit([&, first, last](int) {
+      bool redraw = false;
+      for (int i = first; i < last; i++) {
+        auto &c8 = machines[i];
+        cursors[i] = script.Apply(c8, frame, cursors[i]);
+        c8.RunFrame(cyclesPerFrame);
+
+        // Nobody listens for the beep
+        c8.beep = false;
+
+        if (c8.redraw) {
+          c8.redraw = false;
+          PackDisplay(c8, &frames[i * OBSERVATION_HEIGHT]);
+          redraw = true;
+        }
+      }
+
+      if (redraw) {
+        changed = true;
+      }
+    });
+  }
+
+  pool.Wait();
+  frame++;
+
+  return changed;
+}
+} // namespace chip8
@@ -0,0 +1,244 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "latency.hpp"
+#include "netplay.hpp"
+
+#define NETPLAY_MAGIC 0x504E3843 // "C8NP"
+
+// Packet layout, little endian:
+//   u32 magic
+//   u32 ack    Frames of the receiver's input the sender has
+//   u32 first  Frame of the first input in this packet
+//   u8  count  Number of inputs that follow
+//   u16 keys[count]
+#define NETPLAY_HEADER_SIZE 13
+
+namespace chip8 {
+static void put32(uint8_t *p, uint32_t v) {
+  p[0] = v;
+  p[1] = v >> 8;
+  p[2] = v >> 16;
+  p[3] = v >> 24;
+}
+
+static uint32_t get32(const uint8_t *p) {
+  return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+Netplay::Netplay(Chip8 *c8, int cyclesPerFrame)
+    : interp(c8), cyclesPerFrame(cyclesPerFrame), snapshots(NETPLAY_RING) {
+  localInput.fill(0);
+  remoteInput.fill(0);
+}
+
+Netplay::~Netplay() {
+  if (sock != -1) {
+#ifdef _WIN32
+    closesocket((SOCKET)sock);
+    WSACleanup();
+#else
+    close(sock);
+#endif
+  }
+}
+
+bool Netplay::Connect(uint16_t localPort, const std::string &host,
+                      uint16_t port) {
+#ifdef _WIN32
+  WSADATA wsa;
+  if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+    return false;
+  }
+#endif
+
+  addrinfo hints = {};
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_DGRAM;
+
+  addrinfo *remote;
+  if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints,
+                  &remote) != 0) {
+    std::cerr << "Netplay: unable to resolve " << host << std::endl;
+    return false;
+  }
+
+  sock = socket(AF_INET, SOCK_DGRAM, 0);
+
+  sockaddr_in local = {};
+  local.sin_family = AF_INET;
+  local.sin_addr.s_addr = htonl(INADDR_ANY);
+  local.sin_port = htons(localPort);
+
+  // A connected UDP socket only hears from the peer, so no address juggling
+  // on every send and receive
+  bool ok = sock != -1 &&
+            bind(sock, (sockaddr *)&local, sizeof(local)) == 0 &&
+            connect(sock, remote->ai_addr, (int)remote->ai_addrlen) == 0;
+  freeaddrinfo(remote);
+
+  if (!ok) {
+    std::cerr << "Netplay: unable to bind port " << localPort << std::endl;
+    return false;
+  }
+
+  // Never block the frame on the network
+#ifdef _WIN32
+  u_long nonBlocking = 1;
+  ioctlsocket((SOCKET)sock, FIONBIO, &nonBlocking);
+#else
+  fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK);
+#endif
+
+  return true;
+}
+
+void Netplay::simulate(uint32_t f) {
+  // Predict the remote keys as the last ones we know of
+  if (f >= remoteFrames) {
+    remoteInput[f % NETPLAY_RING] =
+        remoteFrames > 0 ? remoteInput[(remoteFrames - 1) % NETPLAY_RING] : 0;
+  }
+
+  snapshots[f % NETPLAY_RING] = *interp;
+
+  uint16_t keys = localInput[f % NETPLAY_RING] | remoteInput[f % NETPLAY_RING];
+  for (int i = 0; i < 16; i++) {
+    interp->SetKey(i, (keys >> i) & 1);
+  }
+
+  interp->RunFrame(cyclesPerFrame);
+}
+
+void Netplay::send() {
+  uint8_t packet[NETPLAY_HEADER_SIZE + NETPLAY_RING * 2];
+
+  // Resend everything the remote has not acknowledged yet. Packets are tiny
+  // and this makes a lost one cost nothing
+  uint32_t oldest = frame > NETPLAY_RING ? frame - NETPLAY_RING : 0;
+  uint32_t first = std::max(remoteAck, oldest);
+  uint8_t count =
+      frame > first ? std::min<uint32_t>(frame - first, NETPLAY_RING) : 0;
+
+  put32(packet, NETPLAY_MAGIC);
+  put32(packet + 4, remoteFrames);
+  put32(packet + 8, first);
+  packet[12] = count;
+
+  for (int i = 0; i < count; i++) {
+    uint16_t keys = localInput[(first + i) % NETPLAY_RING];
+    packet[NETPLAY_HEADER_SIZE + i * 2] = keys;
+    packet[NETPLAY_HEADER_SIZE + i * 2 + 1] = keys >> 8;
+  }
+
+  ::send(sock, (const char *)packet, NETPLAY_HEADER_SIZE + count * 2, 0);
+}
+
+uint32_t Netplay::receive() {
+  uint8_t packet[NETPLAY_HEADER_SIZE + NETPLAY_RING * 2];
+  uint32_t rollbackFrom = frame;
+
+  int size;
+  while ((size = recv(sock, (char *)packet, sizeof(packet), 0)) > 0) {
+    if (size < NETPLAY_HEADER_SIZE || get32(packet) != NETPLAY_MAGIC ||
+        size < NETPLAY_HEADER_SIZE + packet[12] * 2) {
+      continue;
+    }
+
+    uint32_t first = get32(packet + 8);
+    uint8_t count = packet[12];
+
+    // The remote can't be more than a ring ahead of us, it stalls first.
+    // Anything else is garbage that would overwrite input still in use
+    if (count > NETPLAY_RING ||
+        (uint64_t)first + count > (uint64_t)frame + NETPLAY_RING) {
+      continue;
+    }
+
+    // Nobody can have input for frames we haven't run yet
+    remoteAck = std::max(remoteAck, std::min(get32(packet + 4), frame));
+
+    // Only take input that extends what we know without a gap
+    for (uint32_t f = std::max(first, remoteFrames); f < first + count; f++) {
+      if (f != remoteFrames) {
+        break;
+      }
+
+      uint16_t keys = packet[NETPLAY_HEADER_SIZE + (f - first) * 2] |
+                      packet[NETPLAY_HEADER_SIZE + (f - first) * 2 + 1] << 8;
+
+      // Already emulated with a prediction that turned out wrong
+      if (f < frame && remoteInput[f % NETPLAY_RING] != keys) {
+        rollbackFrom = std::min(rollbackFrom, f);
+      }
+
+      remoteInput[f % NETPLAY_RING] = keys;
+      remoteFrames++;
+    }
+  }
+
+  return rollbackFrom;
+}
+
+bool Netplay::AdvanceFrame(uint16_t localKeys) {
+  uint32_t rollbackFrom = receive();
+
+  if (rollbackFrom < frame) {
+    auto start = std::chrono::steady_clock::now();
+
+    // A beep that already went out should not go out again
+    bool beep = interp->beep;
+
+    // The cycle count goes back too, latency measured across it would wrap
+    *interp = snapshots[rollbackFrom % NETPLAY_RING];
+    if (interp->probe != nullptr) {
+      interp->probe->Rewind(interp->cycles);
+    }
+
+    interp->speculative = true;
+    for (uint32_t f = rollbackFrom; f < frame; f++) {
+      simulate(f);
+    }
+
+    interp->speculative = false;
+    interp->beep = beep;
+    interp->redraw = true;
+    interp->dirtyRows = 0xFFFFFFFF; // The snapshot forgot what was uploaded
+
+    rollbacks++;
+    lastRollbackFrames = frame - rollbackFrom;
+    lastRollbackMicros = std::chrono::duration<double, std::micro>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+    maxRollbackMicros = std::max(maxRollbackMicros, lastRollbackMicros);
+  }
+
+  // Too far ahead to roll back if the remote disagrees. Wait for it
+  if (frame >= remoteFrames + NETPLAY_MAX_ROLLBACK) {
+    stalls++;
+    send();
+    return false;
+  }
+
+  localInput[frame % NETPLAY_RING] = localKeys;
+  simulate(frame);
+  frame++;
+
+  send();
+  return true;
+}
+} // namespace chip8
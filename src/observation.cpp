@@ -0,0 +1,182 @@
+#include <algorithm>
+#include <cstring>
+
+#include "cpu.hpp"
+#include "observation.hpp"
+
+#ifdef CHIP8_AVX2_KERNELS
+#include <immintrin.h>
+#endif
+
+static_assert(sizeof(bool) == 1, "the display is read as bytes");
+
+namespace chip8 {
+#ifdef CHIP8_AVX2_KERNELS
+CHIP8_AVX2_TARGET static void packAVX2(const uint8_t *pixels,
+                                       PackedFrame out) {
+  for (int y = 0; y < OBSERVATION_HEIGHT; y++) {
+    const uint8_t *row = pixels + y * OBSERVATION_WIDTH;
+
+    // Pixels are 0 or 1, move that bit to the top of the byte for movemask
+    __m256i lo = _mm256_loadu_si256((const __m256i *)row);
+    __m256i hi = _mm256_loadu_si256((const __m256i *)(row + 32));
+    uint32_t left = _mm256_movemask_epi8(_mm256_slli_epi16(lo, 7));
+    uint32_t right = _mm256_movemask_epi8(_mm256_slli_epi16(hi, 7));
+    out[y] = left | (uint64_t)right << 32;
+  }
+}
+
+CHIP8_AVX2_TARGET static void expandU8AVX2(const PackedFrame frame,
+                                           uint8_t *out, uint8_t on) {
+  // Byte i of a 32 byte chunk tests bit i % 8 of byte i / 8
+  const __m256i bytes = _mm256_setr_epi8(
+      0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, //
+      2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+  const __m256i bit = _mm256_set1_epi64x(0x8040201008040201);
+  const __m256i value = _mm256_set1_epi8((char)on);
+
+  for (int y = 0; y < OBSERVATION_HEIGHT; y++) {
+    for (int half = 0; half < 2; half++) {
+      uint32_t bits = frame[y] >> (half * 32);
+      __m256i v = _mm256_shuffle_epi8(_mm256_set1_epi32((int)bits), bytes);
+      v = _mm256_cmpeq_epi8(_mm256_and_si256(v, bit), bit);
+      _mm256_storeu_si256((__m256i *)(out + y * OBSERVATION_WIDTH + half * 32),
+                          _mm256_and_si256(v, value));
+    }
+  }
+}
+
+CHIP8_AVX2_TARGET static void expandFloatAVX2(const PackedFrame frame,
+                                              float *out) {
+  const __m256i bit = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+  const __m256 one = _mm256_set1_ps(1.0f);
+
+  for (int y = 0; y < OBSERVATION_HEIGHT; y++) {
+    for (int x = 0; x < OBSERVATION_WIDTH; x += 8) {
+      __m256i v = _mm256_set1_epi32((int)((frame[y] >> x) & 0xFF));
+      v = _mm256_cmpeq_epi32(_mm256_and_si256(v, bit), bit);
+      _mm256_storeu_ps(out + y * OBSERVATION_WIDTH + x,
+                       _mm256_and_ps(_mm256_castsi256_ps(v), one));
+    }
+  }
+}
+#endif
+
+void PackDisplay(const Chip8 &c8, PackedFrame out) {
+  PackDisplay(c8.display, out);
+}
+
+void PackDisplay(const std::array<bool, OBSERVATION_SIZE> &display,
+                 PackedFrame out) {
+  const uint8_t *pixels = (const uint8_t *)display.data();
+
+#ifdef CHIP8_AVX2_KERNELS
+  if (HasAVX2()) {
+    packAVX2(pixels, out);
+    return;
+  }
+#endif
+
+  for (int y = 0; y < OBSERVATION_HEIGHT; y++) {
+    const uint8_t *row = pixels + y * OBSERVATION_WIDTH;
+    uint64_t bits = 0;
+    for (int x = 0; x < OBSERVATION_WIDTH; x++) {
+      bits |= (uint64_t)row[x] << x;
+    }
+    out[y] = bits;
+  }
+}
+
+void ExpandU8(const PackedFrame frame, uint8_t *out, uint8_t on) {
+#ifdef CHIP8_AVX2_KERNELS
+  if (HasAVX2()) {
+    expandU8AVX2(frame, out, on);
+    return;
+  }
+#endif
+
+  for (int y = 0; y < OBSERVATION_HEIGHT; y++) {
+    for (int x = 0; x < OBSERVATION_WIDTH; x++) {
+      out[y * OBSERVATION_WIDTH + x] = (frame[y] >> x) & 1 ? on : 0;
+    }
+  }
+}
+
+void ExpandFloat(const PackedFrame frame, float *out) {
+#ifdef CHIP8_AVX2_KERNELS
+  if (HasAVX2()) {
+    expandFloatAVX2(frame, out);
+    return;
+  }
+#endif
+
+  for (int y = 0; y < OBSERVATION_HEIGHT; y++) {
+    for (int x = 0; x < OBSERVATION_WIDTH; x++) {
+      out[y * OBSERVATION_WIDTH + x] = (float)((frame[y] >> x) & 1);
+    }
+  }
+}
+
+// Gathers the even bits of v into the low 32 bits
+static uint32_t evenBits(uint64_t v) {
+  v &= 0x5555555555555555ull;
+  v = (v | v >> 1) & 0x3333333333333333ull;
+  v = (v | v >> 2) & 0x0F0F0F0F0F0F0F0Full;
+  v = (v | v >> 4) & 0x00FF00FF00FF00FFull;
+  v = (v | v >> 8) & 0x0000FFFF0000FFFFull;
+  v = (v | v >> 16) & 0x00000000FFFFFFFFull;
+  return (uint32_t)v;
+}
+
+void Downsample2x(const PackedFrame frame,
+                  uint32_t out[OBSERVATION_HEIGHT / 2]) {
+  for (int y = 0; y < OBSERVATION_HEIGHT / 2; y++) {
+    uint64_t rows = frame[y * 2] | frame[y * 2 + 1];
+    out[y] = evenBits(rows | rows >> 1);
+  }
+}
+
+FrameStack::FrameStack(int depth, bool maxPool)
+    : depth(depth), maxPool(maxPool), ring(depth * OBSERVATION_HEIGHT) {}
+
+void FrameStack::Clear() {
+  pushed = 0;
+  std::fill(ring.begin(), ring.end(), 0);
+  memset(previous, 0, sizeof(previous));
+}
+
+void FrameStack::Push(const PackedFrame frame) {
+  uint64_t *slot = &ring[(pushed % depth) * OBSERVATION_HEIGHT];
+
+  for (int y = 0; y < OBSERVATION_HEIGHT; y++) {
+    slot[y] = maxPool ? frame[y] | previous[y] : frame[y];
+  }
+
+  memcpy(previous, frame, sizeof(previous));
+  pushed++;
+}
+
+void FrameStack::Push(const Chip8 &c8) {
+  PackedFrame frame;
+  PackDisplay(c8, frame);
+  Push(frame);
+}
+
+const uint64_t *FrameStack::Frame(int age) const {
+  // Before the ring fills up the unused slots are still zero
+  int slot = ((pushed - 1 - age) % depth + depth) % depth;
+  return &ring[slot * OBSERVATION_HEIGHT];
+}
+
+void FrameStack::ExpandU8(uint8_t *out, uint8_t on) const {
+  for (int i = 0; i < depth; i++) {
+    chip8::ExpandU8(Frame(depth - 1 - i), out + i * OBSERVATION_SIZE, on);
+  }
+}
+
+void FrameStack::ExpandFloat(float *out) const {
+  for (int i = 0; i < depth; i++) {
+    chip8::ExpandFloat(Frame(depth - 1 - i), out + i * OBSERVATION_SIZE);
+  }
+}
+} // namespace chip8
@@ -0,0 +1,122 @@
+#include <cmath>
+#include <cstring>
+
+#include "cpu.hpp"
+#include "palette.hpp"
+
+#ifdef CHIP8_AVX2_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace chip8 {
+#ifdef CHIP8_AVX2_KERNELS
+// Output byte j of 32 pixels belongs to pixel j / 3. For each of the three 32
+// byte stores, which byte of the pixels' 32 bits to look at and which bit
+static struct Masks {
+  alignas(32) uint8_t byte[3][32];
+  alignas(32) uint8_t bit[3][32];
+
+  Masks() {
+    for (int chunk = 0; chunk < 3; chunk++) {
+      for (int j = 0; j < 32; j++) {
+        int pixel = (chunk * 32 + j) / 3;
+        byte[chunk][j] = pixel / 8;
+        bit[chunk][j] = 1 << (pixel % 8);
+      }
+    }
+  }
+} masks;
+
+CHIP8_AVX2_TARGET static void toRGBAVX2(const uint8_t *fgPattern,
+                                        const uint8_t *bgPattern,
+                                        const uint64_t *words, int count,
+                                        uint8_t *out) {
+  __m256i fgs[3], bgs[3], bytes[3], bits[3];
+  for (int chunk = 0; chunk < 3; chunk++) {
+    fgs[chunk] = _mm256_load_si256((const __m256i *)(fgPattern + chunk * 32));
+    bgs[chunk] = _mm256_load_si256((const __m256i *)(bgPattern + chunk * 32));
+    bytes[chunk] = _mm256_load_si256((const __m256i *)masks.byte[chunk]);
+    bits[chunk] = _mm256_load_si256((const __m256i *)masks.bit[chunk]);
+  }
+
+  for (int w = 0; w < count; w++) {
+    for (int half = 0; half < 2; half++) {
+      __m256i pixels = _mm256_set1_epi32((int)(words[w] >> (half * 32)));
+
+      for (int chunk = 0; chunk < 3; chunk++) {
+        __m256i v = _mm256_shuffle_epi8(pixels, bytes[chunk]);
+        v = _mm256_cmpeq_epi8(_mm256_and_si256(v, bits[chunk]), bits[chunk]);
+        _mm256_storeu_si256((__m256i *)out,
+                            _mm256_blendv_epi8(bgs[chunk], fgs[chunk], v));
+        out += 32;
+      }
+    }
+  }
+}
+#endif
+
+Palette::Palette() {
+  const uint8_t green[3] = {0x00, 0xFF, 0x9B};
+  const uint8_t black[3] = {0x0B, 0x0B, 0x0B};
+  Set(green, black);
+}
+
+Palette::Palette(const uint8_t fg[3], const uint8_t bg[3]) { Set(fg, bg); }
+
+void Palette::Set(const uint8_t fg[3], const uint8_t bg[3]) {
+  memcpy(this->fg, fg, 3);
+  memcpy(this->bg, bg, 3);
+
+  for (int i = 0; i < 96; i++) {
+    fgPattern[i] = fg[i % 3];
+    bgPattern[i] = bg[i % 3];
+  }
+
+  for (int byte = 0; byte < 256; byte++) {
+    for (int pixel = 0; pixel < 8; pixel++) {
+      memcpy(lut[byte] + pixel * 3, (byte >> pixel) & 1 ? fg : bg, 3);
+    }
+  }
+
+  for (int i = 0; i < 256; i++) {
+    for (int c = 0; c < 3; c++) {
+      ramp[i][c] = bg[c] + std::lround((fg[c] - bg[c]) * i / 255.0);
+    }
+    ramp[i][3] = 0;
+  }
+}
+
+bool Palette::Matches(const uint8_t fg[3], const uint8_t bg[3]) const {
+  return memcmp(this->fg, fg, 3) == 0 && memcmp(this->bg, bg, 3) == 0;
+}
+
+void Palette::ToRGB(const PackedFrame frame, uint8_t *out) const {
+  ToRGB(frame, OBSERVATION_HEIGHT, out);
+}
+
+void Palette::ToRGB(const uint64_t *words, int count, uint8_t *out) const {
+#ifdef CHIP8_AVX2_KERNELS
+  if (HasAVX2()) {
+    toRGBAVX2(fgPattern, bgPattern, words, count, out);
+    return;
+  }
+#endif
+
+  for (int w = 0; w < count; w++) {
+    for (int byte = 0; byte < 8; byte++) {
+      memcpy(out, lut[(words[w] >> (byte * 8)) & 0xFF], 24);
+      out += 24;
+    }
+  }
+}
+
+void Palette::ToRGB(const uint8_t *intensity, uint8_t *out) const {
+  // 4 byte copies, the padding byte is overwritten by the next pixel. The
+  // last pixel must not write past the end
+  for (int i = 0; i < OBSERVATION_SIZE - 1; i++) {
+    memcpy(out + i * 3, ramp[intensity[i]], 4);
+  }
+
+  memcpy(out + PALETTE_RGB_SIZE - 3, ramp[intensity[OBSERVATION_SIZE - 1]], 3);
+}
+} // namespace chip8
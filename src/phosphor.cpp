@@ -0,0 +1,86 @@
+#include <chrono>
+#include <cstring>
+
+#include "cpu.hpp"
+#include "phosphor.hpp"
+
+#ifdef CHIP8_AVX2_KERNELS
+#include <immintrin.h>
+#endif
+
+using std::chrono::steady_clock;
+
+namespace chip8 {
+#ifdef CHIP8_AVX2_KERNELS
+CHIP8_AVX2_TARGET static bool applyAVX2(uint8_t *intensity, uint8_t decay,
+                                        const PackedFrame frame) {
+  // Same bit to byte expansion as ExpandU8
+  const __m256i bytes = _mm256_setr_epi8(
+      0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, //
+      2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+  const __m256i bit = _mm256_set1_epi64x(0x8040201008040201);
+  const __m256i scale = _mm256_set1_epi16(decay);
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i fading = zero;
+
+  for (int y = 0; y < OBSERVATION_HEIGHT; y++) {
+    for (int half = 0; half < 2; half++) {
+      uint32_t bits = frame[y] >> (half * 32);
+      __m256i lit = _mm256_shuffle_epi8(_mm256_set1_epi32((int)bits), bytes);
+      lit = _mm256_cmpeq_epi8(_mm256_and_si256(lit, bit), bit);
+
+      // Widen to 16 bits for the multiply. Unpack and pack both work within
+      // 128 bit lanes, so the bytes come back in order
+      __m256i *p = (__m256i *)(intensity + y * OBSERVATION_WIDTH + half * 32);
+      __m256i v = _mm256_load_si256(p);
+      __m256i lo = _mm256_mullo_epi16(_mm256_unpacklo_epi8(v, zero), scale);
+      __m256i hi = _mm256_mullo_epi16(_mm256_unpackhi_epi8(v, zero), scale);
+      v = _mm256_packus_epi16(_mm256_srli_epi16(lo, 8),
+                              _mm256_srli_epi16(hi, 8));
+
+      fading = _mm256_or_si256(fading, _mm256_andnot_si256(lit, v));
+      _mm256_store_si256(p, _mm256_or_si256(v, lit));
+    }
+  }
+
+  return !_mm256_testz_si256(fading, fading);
+}
+#endif
+
+static bool apply(uint8_t *intensity, uint8_t decay, const PackedFrame frame) {
+#ifdef CHIP8_AVX2_KERNELS
+  if (HasAVX2()) {
+    return applyAVX2(intensity, decay, frame);
+  }
+#endif
+
+  // Branch free, so the compiler can vectorize it on its own
+  uint8_t fading = 0;
+
+  for (int y = 0; y < OBSERVATION_HEIGHT; y++) {
+    for (int x = 0; x < OBSERVATION_WIDTH; x++) {
+      uint8_t &v = intensity[y * OBSERVATION_WIDTH + x];
+      uint8_t lit = -(uint8_t)((frame[y] >> x) & 1);
+      uint8_t faded = v * decay >> 8;
+      fading |= faded & ~lit;
+      v = faded | lit;
+    }
+  }
+
+  return fading != 0;
+}
+
+Phosphor::Phosphor(uint8_t decay) : decay(decay) {}
+
+void Phosphor::Clear() { memset(intensity, 0, sizeof(intensity)); }
+
+bool Phosphor::Apply(const PackedFrame frame) {
+  auto start = steady_clock::now();
+  bool fading = apply(intensity, decay, frame);
+
+  applyNanos.Add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                     steady_clock::now() - start)
+                     .count());
+  return fading;
+}
+} // namespace chip8
@@ -0,0 +1,394 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "recorder.hpp"
+#include "upscale.hpp"
+
+// LZW as GIF does it: 2 bit pixels (the smallest GIF allows), codes of 3 to
+// 12 bits
+#define GIF_MIN_CODE_SIZE 2
+#define GIF_CLEAR (1 << GIF_MIN_CODE_SIZE)
+#define GIF_END (GIF_CLEAR + 1)
+#define GIF_MAX_CODES 4096
+
+namespace chip8 {
+// BT.601, limited range, what players assume for Y4M without a color tag
+static void toYUV(const uint8_t rgb[3], uint8_t yuv[3]) {
+  double r = rgb[0], g = rgb[1], b = rgb[2];
+  yuv[0] = std::lround(16 + (65.481 * r + 128.553 * g + 24.966 * b) / 255);
+  yuv[1] = std::lround(128 + (-37.797 * r - 74.203 * g + 112.0 * b) / 255);
+  yuv[2] = std::lround(128 + (112.0 * r - 93.786 * g - 18.214 * b) / 255);
+}
+
+static void put16(std::ofstream &file, int v) {
+  file.put((char)(v & 0xFF));
+  file.put((char)(v >> 8));
+}
+
+// Hundredths of a second since the first frame, at 60 frames a second
+static uint64_t centiseconds(uint64_t frame) { return (frame * 5 + 1) / 3; }
+
+VideoFormat VideoFormatFromName(const std::string &filename) {
+  auto ends = [&](const char *suffix) {
+    size_t n = strlen(suffix);
+    return filename.size() >= n &&
+           filename.compare(filename.size() - n, n, suffix) == 0;
+  };
+
+  if (ends(".y4m")) {
+    return VideoFormat::Y4M;
+  }
+
+  if (ends(".gif")) {
+    return VideoFormat::GIF;
+  }
+
+  return VideoFormat::Raw;
+}
+
+Recorder::~Recorder() { Close(); }
+
+bool Recorder::Open(const std::string &filename,
+                    const RecorderOptions &options) {
+  Close();
+
+  file.open(filename, std::ios::binary | std::ios::trunc);
+  if (!file) {
+    return false;
+  }
+
+  this->options = options;
+  this->options.scale = std::max(options.scale, 1);
+  this->options.capacity = std::max(options.capacity, 1);
+
+  width = OBSERVATION_WIDTH * this->options.scale;
+  height = OBSERVATION_HEIGHT * this->options.scale;
+
+  palette.Set(options.fg, options.bg);
+  toYUV(options.fg, fgYUV);
+  toYUV(options.bg, bgYUV);
+  rgb.resize(PALETTE_RGB_SIZE);
+  pixels.resize((size_t)width * height * 3);
+
+  ring.assign(this->options.capacity, Slot());
+  head = 0;
+  tail = 0;
+  closing = false;
+  captured = 0;
+  dropped = 0;
+  blocked = 0;
+  encoded = 0;
+  hasPending = false;
+
+  switch (options.format) {
+  case VideoFormat::Y4M:
+    file << "YUV4MPEG2 W" << width << " H" << height
+         << " F60:1 Ip A1:1 C444\n";
+    break;
+
+  case VideoFormat::GIF:
+    writeGIFHeader();
+    break;
+
+  case VideoFormat::Raw:
+    break;
+  }
+
+  encoder = std::thread(&Recorder::run, this);
+  return true;
+}
+
+void Recorder::Capture(const Chip8 &c8) {
+  PackedFrame frame;
+  PackDisplay(c8, frame);
+  Capture(frame);
+}
+
+void Recorder::Capture(const PackedFrame frame) {
+  if (!encoder.joinable()) {
+    return;
+  }
+
+  captured.fetch_add(1, std::memory_order_relaxed);
+
+  uint64_t h = head.load(std::memory_order_relaxed);
+  uint64_t t = tail.load(std::memory_order_acquire);
+  size_t capacity = ring.size();
+
+  if (h - t >= capacity) {
+    if (options.backpressure == Backpressure::Drop) {
+      dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+
+    blocked.fetch_add(1, std::memory_order_relaxed);
+    while (h - t >= capacity) {
+      tail.wait(t, std::memory_order_acquire);
+      t = tail.load(std::memory_order_acquire);
+    }
+  }
+
+  memcpy(ring[h % capacity].frame, frame, sizeof(PackedFrame));
+  head.store(h + 1, std::memory_order_release);
+
+  signal.fetch_add(1, std::memory_order_release);
+  signal.notify_one();
+}
+
+void Recorder::Close() {
+  if (!encoder.joinable()) {
+    return;
+  }
+
+  closing = true;
+  signal.fetch_add(1, std::memory_order_release);
+  signal.notify_one();
+
+  encoder.join();
+  file.close();
+}
+
+void Recorder::run() {
+  size_t capacity = ring.size();
+
+  while (true) {
+    // Read before looking at head, so a push in between changes it and the
+    // wait below returns right away
+    uint32_t seen = signal.load(std::memory_order_acquire);
+    uint64_t t = tail.load(std::memory_order_relaxed);
+
+    if (t == head.load(std::memory_order_acquire)) {
+      if (closing) {
+        break;
+      }
+
+      signal.wait(seen, std::memory_order_acquire);
+      continue;
+    }
+
+    encode(ring[t % capacity].frame);
+
+    tail.store(t + 1, std::memory_order_release);
+    tail.notify_one();
+  }
+
+  finish();
+}
+
+void Recorder::encode(const PackedFrame frame) {
+  uint64_t number = encoded++;
+
+  switch (options.format) {
+  case VideoFormat::Raw: {
+    palette.ToRGB(frame, rgb.data());
+    const uint8_t *out = rgb.data();
+
+    if (options.scale > 1) {
+      ScaleNearest(rgb.data(), OBSERVATION_WIDTH, OBSERVATION_HEIGHT,
+                   options.scale, pixels.data());
+      out = pixels.data();
+    }
+
+    file.write((const char *)out, (size_t)width * height * 3);
+    break;
+  }
+
+  case VideoFormat::Y4M:
+    writeY4M(frame);
+    break;
+
+  case VideoFormat::GIF: {
+    if (!hasPending) {
+      memcpy(pending, frame, sizeof(PackedFrame));
+      pendingSince = number;
+      hasPending = true;
+      break;
+    }
+
+    if (memcmp(pending, frame, sizeof(PackedFrame)) == 0) {
+      break;
+    }
+
+    // Most viewers treat delays under 2/100s as 10/100s. A frame that would
+    // be shown for less than that is replaced by the next one instead
+    uint64_t delay = centiseconds(number) - centiseconds(pendingSince);
+    if (delay >= 2) {
+      writeGIFFrame(pending, (int)delay);
+      pendingSince = number;
+    }
+
+    memcpy(pending, frame, sizeof(PackedFrame));
+    break;
+  }
+  }
+}
+
+void Recorder::writeY4M(const PackedFrame frame) {
+  file << "FRAME\n";
+
+  // Two colors only, so each plane is a choice between two bytes
+  for (int plane = 0; plane < 3; plane++) {
+    uint8_t *out = pixels.data();
+
+    for (int y = 0; y < height; y++) {
+      uint64_t row = frame[y / options.scale];
+      for (int x = 0; x < width; x++) {
+        *out++ = (row >> (x / options.scale)) & 1 ? fgYUV[plane]
+                                                  : bgYUV[plane];
+      }
+    }
+
+    file.write((const char *)pixels.data(), (size_t)width * height);
+  }
+}
+
+void Recorder::writeGIFHeader() {
+  file << "GIF89a";
+  put16(file, width);
+  put16(file, height);
+
+  // Global color table of 2 entries (bg, fg), shared by every frame
+  file.put((char)0xF0);
+  file.put(0); // Background color index
+  file.put(0); // Square pixels
+  file.write((const char *)options.bg, 3);
+  file.write((const char *)options.fg, 3);
+
+  // Loop forever
+  file.put(0x21);
+  file.put((char)0xFF);
+  file.put(11);
+  file << "NETSCAPE2.0";
+  file.put(3);
+  file.put(1);
+  put16(file, 0);
+  file.put(0);
+}
+
+void Recorder::writeGIFFrame(const PackedFrame frame, int delay) {
+  // Only the rows that differ from what is on screen, the rest is left as
+  // it was (disposal method 1)
+  int first = 0;
+  while (first < OBSERVATION_HEIGHT - 1 && frame[first] == shown[first]) {
+    first++;
+  }
+
+  int last = OBSERVATION_HEIGHT - 1;
+  while (last > first && frame[last] == shown[last]) {
+    last--;
+  }
+
+  memcpy(shown, frame, sizeof(PackedFrame));
+
+  file.put(0x21);
+  file.put((char)0xF9);
+  file.put(4);
+  file.put(1 << 2);
+  put16(file, std::min(delay, 0xFFFF));
+  file.put(0);
+  file.put(0);
+
+  int top = first * options.scale;
+  int rows = (last - first + 1) * options.scale;
+
+  file.put(0x2C);
+  put16(file, 0);
+  put16(file, top);
+  put16(file, width);
+  put16(file, rows);
+  file.put(0);
+
+  uint8_t *out = pixels.data();
+  for (int y = top; y < top + rows; y++) {
+    uint64_t row = frame[y / options.scale];
+    for (int x = 0; x < width; x++) {
+      *out++ = (row >> (x / options.scale)) & 1;
+    }
+  }
+
+  writeLZW(pixels.data(), (size_t)width * rows);
+}
+
+void Recorder::writeLZW(const uint8_t *indices, size_t count) {
+  std::vector<uint8_t> data;
+  uint32_t bits = 0;
+  int pending = 0;
+
+  auto put = [&](int code, int size) {
+    bits |= (uint32_t)code << pending;
+    pending += size;
+    while (pending >= 8) {
+      data.push_back(bits & 0xFF);
+      bits >>= 8;
+      pending -= 8;
+    }
+  };
+
+  int codeSize = GIF_MIN_CODE_SIZE + 1;
+  int next = GIF_END + 1;
+  lzw.assign(GIF_MAX_CODES * 4, 0);
+
+  put(GIF_CLEAR, codeSize);
+
+  int prefix = indices[0];
+  for (size_t i = 1; i < count; i++) {
+    uint16_t &child = lzw[prefix * 4 + indices[i]];
+    if (child != 0) {
+      prefix = child;
+      continue;
+    }
+
+    put(prefix, codeSize);
+    child = next++;
+
+    // The decoder adds its entry one code later, so it widens once the
+    // table size reaches the limit, not when it passes it
+    if (next > (1 << codeSize) && codeSize < 12) {
+      codeSize++;
+    }
+
+    if (next == GIF_MAX_CODES) {
+      put(GIF_CLEAR, codeSize);
+      codeSize = GIF_MIN_CODE_SIZE + 1;
+      next = GIF_END + 1;
+      std::fill(lzw.begin(), lzw.end(), 0);
+    }
+
+    prefix = indices[i];
+  }
+
+  put(prefix, codeSize);
+
+  // No entry for the last code, but the decoder adds one and may widen
+  if (next == (1 << codeSize) && codeSize < 12) {
+    codeSize++;
+  }
+
+  put(GIF_END, codeSize);
+  if (pending > 0) {
+    data.push_back(bits & 0xFF);
+  }
+
+  file.put(GIF_MIN_CODE_SIZE);
+  for (size_t at = 0; at < data.size(); at += 255) {
+    size_t size = std::min<size_t>(255, data.size() - at);
+    file.put((char)size);
+    file.write((const char *)data.data() + at, size);
+  }
+  file.put(0);
+}
+
+void Recorder::finish() {
+  if (options.format == VideoFormat::GIF) {
+    if (hasPending) {
+      uint64_t delay = centiseconds(encoded) - centiseconds(pendingSince);
+      writeGIFFrame(pending, (int)std::max<uint64_t>(delay, 2));
+    }
+
+    file.put(0x3B);
+  }
+
+  file.flush();
+}
+} // namespace chip8
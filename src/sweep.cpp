@@ -0,0 +1,145 @@
+#include <algorithm>
+#include <map>
+#include <utility>
+
+#include "batch.hpp"
+#include "input_script.hpp"
+#include "sweep.hpp"
+
+namespace chip8 {
+enum class Stop { None, Random, Until };
+
+// Chip8::RunFrame, one instruction at a time so a run can stop right before
+// a given instruction. `done` carries over into a resumed frame
+static Stop runFrame(Chip8 &c8, int cycles, int &done, int untilPc,
+                     bool beforeRandom) {
+  while (done < cycles) {
+    if (c8.pc == untilPc) {
+      return Stop::Until;
+    }
+
+    if (beforeRandom && (c8.mem[c8.pc & 0xFFF] & 0xF0) == 0xC0) {
+      return Stop::Random;
+    }
+
+    c8.Tick();
+    done++;
+
+    if (c8.waitingForKey) {
+      break;
+    }
+  }
+
+  c8.TickTimer();
+  done = 0;
+  return Stop::None;
+}
+
+SeedSweep::SeedSweep(int threads, int cyclesPerFrame, bool pin)
+    : pool(threads, pin), cyclesPerFrame(cyclesPerFrame) {}
+
+bool SeedSweep::Run(const SweepOptions &options, std::vector<SweepRun> &runs,
+                    SweepSummary &summary) {
+  InputScript script;
+  if (!options.input.empty() && !script.Load(options.input)) {
+    return false;
+  }
+
+  Chip8 shared;
+  shared.Reset();
+  if (!shared.LoadProgram(options.rom)) {
+    return false;
+  }
+
+  // Shared prefix, up to the first CXNN
+  size_t cursor = 0;
+  uint64_t frame = 0;
+  int done = 0;
+  Stop stop = Stop::None;
+  while (frame < options.frames) {
+    cursor = script.Apply(shared, frame, cursor);
+    stop = runFrame(shared, cyclesPerFrame, done, options.untilPc, true);
+    if (stop != Stop::None) {
+      break;
+    }
+
+    frame++;
+  }
+
+  summary = SweepSummary();
+  summary.sharedFrames = frame;
+  summary.sharedCycles = shared.cycles;
+
+  runs.assign(options.seeds, SweepRun());
+
+  for (uint32_t first = 0; first < options.seeds; first += SWEEP_CHUNK) {
+    uint32_t last = std::min<uint32_t>(first + SWEEP_CHUNK, options.seeds);
+
+    pool.Submit([&, first, last, frame, cursor, done, stop](int) {
+      Chip8 c8;
+      for (uint32_t i = first; i < last; i++) {
+        c8 = shared;
+        c8.Seed(options.firstSeed + i);
+
+        // Finish the frame the prefix stopped in, then carry on as usual
+        size_t at = cursor;
+        uint64_t f = frame;
+        int resumed = done;
+        Stop s = stop == Stop::Random ? Stop::None : stop;
+
+        if (stop == Stop::Random) {
+          s = runFrame(c8, cyclesPerFrame, resumed, options.untilPc, false);
+          f += s == Stop::None;
+        }
+
+        while (s == Stop::None && f < options.frames) {
+          at = script.Apply(c8, f, at);
+          s = runFrame(c8, cyclesPerFrame, resumed, options.untilPc, false);
+          f += s == Stop::None;
+        }
+
+        auto &run = runs[i];
+        run.seed = options.firstSeed + i;
+        run.hit = s == Stop::Until;
+        run.frames = f;
+        run.cycles = c8.cycles;
+        run.pc = c8.pc;
+        run.displayHash = DisplayHash(c8);
+      }
+    });
+  }
+
+  pool.Wait();
+
+  if (runs.empty()) {
+    return true;
+  }
+
+  std::vector<uint64_t> frames;
+  std::map<std::pair<uint32_t, uint16_t>, uint32_t> outcomes;
+  for (auto &run : runs) {
+    summary.hits += run.hit;
+    summary.meanFrames += run.frames;
+    frames.push_back(run.frames);
+    outcomes[{run.displayHash, run.pc}]++;
+  }
+
+  std::sort(frames.begin(), frames.end());
+  summary.meanFrames /= runs.size();
+  summary.minFrames = frames.front();
+  summary.medianFrames = frames[frames.size() / 2];
+  summary.p90Frames = frames[frames.size() * 9 / 10];
+  summary.maxFrames = frames.back();
+
+  for (auto &[state, count] : outcomes) {
+    summary.outcomes.push_back({state.first, state.second, count});
+  }
+
+  std::stable_sort(summary.outcomes.begin(), summary.outcomes.end(),
+                   [](const SweepOutcome &a, const SweepOutcome &b) {
+                     return a.runs > b.runs;
+                   });
+
+  return true;
+}
+} // namespace chip8
@@ -0,0 +1,227 @@
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#ifdef __linux__
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "thread_pool.hpp"
+
+namespace chip8 {
+#ifdef __linux__
+// "0-3,8-11" as in /sys/devices/system/node/node*/cpulist
+static std::vector<int> parseCPUList(const std::string &list) {
+  std::vector<int> cpus;
+  std::istringstream ranges(list);
+  std::string range;
+
+  while (std::getline(ranges, range, ',')) {
+    int first, last;
+    char dash;
+    std::istringstream in(range);
+    if (!(in >> first)) {
+      continue;
+    }
+
+    if (!(in >> dash >> last)) {
+      last = first;
+    }
+
+    for (int cpu = first; cpu <= last; cpu++) {
+      cpus.push_back(cpu);
+    }
+  }
+
+  return cpus;
+}
+
+// The CPUs we may run on (taskset, cgroups), grouped by NUMA node so
+// workers fill one node before spilling onto the next. CPU numbers say
+// nothing about nodes, those come from sysfs. Without it (no NUMA, no
+// sysfs) the CPUs stay in numeric order
+static std::vector<int> allowedCPUs() {
+  std::vector<int> cpus;
+  cpu_set_t allowed;
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+    return cpus;
+  }
+
+  std::vector<std::pair<int, std::string>> nodes;
+  std::error_code error;
+  for (auto &entry : std::filesystem::directory_iterator(
+           "/sys/devices/system/node", error)) {
+    std::string name = entry.path().filename();
+    if (name.size() > 4 && name.compare(0, 4, "node") == 0 &&
+        std::all_of(name.begin() + 4, name.end(),
+                    [](char c) { return c >= '0' && c <= '9'; })) {
+      nodes.emplace_back(std::stoi(name.substr(4)), entry.path() / "cpulist");
+    }
+  }
+
+  std::sort(nodes.begin(), nodes.end());
+
+  for (auto &node : nodes) {
+    std::ifstream file(node.second);
+    std::string list;
+    std::getline(file, list);
+
+    for (int cpu : parseCPUList(list)) {
+      if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)) {
+        cpus.push_back(cpu);
+        CPU_CLR(cpu, &allowed); // Listed once, even if sysfs disagrees
+      }
+    }
+  }
+
+  // Whatever no node claimed
+  for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (CPU_ISSET(cpu, &allowed)) {
+      cpus.push_back(cpu);
+    }
+  }
+
+  return cpus;
+}
+#endif
+
+ThreadPool::ThreadPool(int count, bool pin) {
+#ifdef __linux__
+  std::vector<int> allowed = allowedCPUs();
+
+  // One per CPU we may use, not per CPU in the machine
+  if (count <= 0 && !allowed.empty()) {
+    count = (int)allowed.size();
+  }
+
+  if (pin) {
+    cpus = std::move(allowed);
+  }
+#endif
+
+  if (count <= 0) {
+    count = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  for (int i = 0; i < count; i++) {
+    workers.push_back(std::make_unique<Worker>());
+  }
+
+  // No destructor runs when this throws, so the workers that did start are
+  // stopped here before passing it on
+  try {
+    for (int i = 0; i < count; i++) {
+      threads.emplace_back(&ThreadPool::run, this, i);
+    }
+  } catch (...) {
+    stop();
+    throw;
+  }
+}
+
+ThreadPool::~ThreadPool() { stop(); }
+
+void ThreadPool::stop() {
+  {
+    std::lock_guard<std::mutex> guard(sleepLock);
+    stopping = true;
+  }
+
+  wake.notify_all();
+  for (auto &thread : threads) {
+    thread.join();
+  }
+}
+
+void ThreadPool::Submit(Task task) {
+  Submit(next++ % workers.size(), std::move(task));
+}
+
+void ThreadPool::Submit(int worker, Task task) {
+  pending++;
+
+  {
+    std::lock_guard<std::mutex> guard(workers[worker]->lock);
+    workers[worker]->tasks.push_back(std::move(task));
+  }
+
+  // Bumped under the sleep lock so a worker about to sleep can't miss it
+  {
+    std::lock_guard<std::mutex> guard(sleepLock);
+    queued++;
+  }
+
+  wake.notify_one();
+}
+
+void ThreadPool::Wait() {
+  std::unique_lock<std::mutex> guard(sleepLock);
+  idle.wait(guard, [this] { return pending == 0; });
+}
+
+bool ThreadPool::pop(int self, Task &task) {
+  // Our own newest task first, it is the most likely to be warm in cache
+  {
+    auto &own = *workers[self];
+    std::lock_guard<std::mutex> guard(own.lock);
+    if (!own.tasks.empty()) {
+      task = std::move(own.tasks.back());
+      own.tasks.pop_back();
+      queued--;
+      return true;
+    }
+  }
+
+  // Then steal the oldest task of the others
+  for (size_t i = 1; i < workers.size(); i++) {
+    auto &victim = *workers[(self + i) % workers.size()];
+    std::lock_guard<std::mutex> guard(victim.lock);
+    if (!victim.tasks.empty()) {
+      task = std::move(victim.tasks.front());
+      victim.tasks.pop_front();
+      queued--;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void ThreadPool::run(int self) {
+#ifdef __linux__
+  if (!cpus.empty()) {
+    cpu_set_t cpu;
+    CPU_ZERO(&cpu);
+    CPU_SET(cpus[self % cpus.size()], &cpu);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu), &cpu);
+  }
+#endif
+
+  for (;;) {
+    Task task;
+    if (pop(self, task)) {
+      task(self);
+
+      if (--pending == 0) {
+        std::lock_guard<std::mutex> guard(sleepLock);
+        idle.notify_all();
+      }
+
+      continue;
+    }
+
+    std::unique_lock<std::mutex> guard(sleepLock);
+    wake.wait(guard, [this] { return stopping || queued > 0; });
+    if (stopping && queued == 0) {
+      return;
+    }
+  }
+}
+} // namespace chip8
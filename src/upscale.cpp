@@ -0,0 +1,159 @@
+#include <cstring>
+
+#include "upscale.hpp"
+
+namespace chip8 {
+// The 3x3 neighbourhood of 64 pixels, one bit each
+struct Neighbours {
+  uint64_t a, b, c; // Up left, up, up right
+  uint64_t d, e, f; // Left, center, right
+  uint64_t g, h, i; // Down left, down, down right
+};
+
+// Pixel x - 1 and x + 1 into bit x, carrying across words
+static uint64_t left(const uint64_t *row, int w) {
+  return row[w] << 1 | (w > 0 ? row[w - 1] >> 63 : row[0] & 1);
+}
+
+static uint64_t right(const uint64_t *row, int w, int words) {
+  return row[w] >> 1 |
+         (w + 1 < words ? row[w + 1] << 63 : row[w] & 1ull << 63);
+}
+
+static Neighbours neighbours(const uint64_t *in, int words, int height, int y,
+                             int w) {
+  const uint64_t *up = in + (y > 0 ? y - 1 : y) * words;
+  const uint64_t *row = in + y * words;
+  const uint64_t *down = in + (y + 1 < height ? y + 1 : y) * words;
+
+  return {
+      left(up, w),   up[w],   right(up, w, words),   //
+      left(row, w),  row[w],  right(row, w, words),  //
+      left(down, w), down[w], right(down, w, words), //
+  };
+}
+
+// Where cond is set take a, elsewhere e
+static uint64_t pick(uint64_t cond, uint64_t a, uint64_t e) {
+  return (cond & a) | (~cond & e);
+}
+
+// The low 32 bits of v into the even bits
+static uint64_t spread2(uint64_t v) {
+  v &= 0xFFFFFFFFull;
+  v = (v | v << 16) & 0x0000FFFF0000FFFFull;
+  v = (v | v << 8) & 0x00FF00FF00FF00FFull;
+  v = (v | v << 4) & 0x0F0F0F0F0F0F0F0Full;
+  v = (v | v << 2) & 0x3333333333333333ull;
+  v = (v | v << 1) & 0x5555555555555555ull;
+  return v;
+}
+
+// Bit k of a byte into bit 3k
+static struct Spread3 {
+  uint32_t bits[256];
+
+  Spread3() {
+    for (int byte = 0; byte < 256; byte++) {
+      bits[byte] = 0;
+      for (int k = 0; k < 8; k++) {
+        bits[byte] |= ((byte >> k) & 1u) << (k * 3);
+      }
+    }
+  }
+} spread3;
+
+// 64 pixels of three sub-pixel columns into 192 bits, pixel x of column k
+// at bit 3x + k
+static void interleave3(uint64_t p0, uint64_t p1, uint64_t p2, uint64_t *out) {
+  out[0] = out[1] = out[2] = 0;
+
+  for (int byte = 0; byte < 8; byte++) {
+    uint64_t bits = spread3.bits[(p0 >> (byte * 8)) & 0xFF] |
+                    spread3.bits[(p1 >> (byte * 8)) & 0xFF] << 1 |
+                    spread3.bits[(p2 >> (byte * 8)) & 0xFF] << 2;
+
+    int at = byte * 24;
+    out[at / 64] |= bits << (at % 64);
+    if (at % 64 > 40) {
+      out[at / 64 + 1] |= bits >> (64 - at % 64);
+    }
+  }
+}
+
+void Scale2x(const uint64_t *in, int words, int height, uint64_t *out) {
+  for (int y = 0; y < height; y++) {
+    uint64_t *top = out + (y * 2) * words * 2;
+    uint64_t *bottom = top + words * 2;
+
+    for (int w = 0; w < words; w++) {
+      auto [a, b, c, d, e, f, g, h, i] = neighbours(in, words, height, y, w);
+      (void)a, (void)c, (void)g, (void)i;
+
+      uint64_t e0 = pick(~(d ^ b) & (b ^ f) & (d ^ h), d, e);
+      uint64_t e1 = pick(~(b ^ f) & (b ^ d) & (f ^ h), f, e);
+      uint64_t e2 = pick(~(d ^ h) & (d ^ b) & (h ^ f), d, e);
+      uint64_t e3 = pick(~(h ^ f) & (h ^ d) & (f ^ b), f, e);
+
+      top[w * 2] = spread2(e0) | spread2(e1) << 1;
+      top[w * 2 + 1] = spread2(e0 >> 32) | spread2(e1 >> 32) << 1;
+      bottom[w * 2] = spread2(e2) | spread2(e3) << 1;
+      bottom[w * 2 + 1] = spread2(e2 >> 32) | spread2(e3 >> 32) << 1;
+    }
+  }
+}
+
+void Scale3x(const uint64_t *in, int words, int height, uint64_t *out) {
+  for (int y = 0; y < height; y++) {
+    uint64_t *rows[3];
+    for (int r = 0; r < 3; r++) {
+      rows[r] = out + (y * 3 + r) * words * 3;
+    }
+
+    for (int w = 0; w < words; w++) {
+      auto [a, b, c, d, e, f, g, h, i] = neighbours(in, words, height, y, w);
+
+      // The four corner cases of EPX
+      uint64_t db = ~(d ^ b) & (d ^ h) & (b ^ f);
+      uint64_t bf = ~(b ^ f) & (b ^ d) & (f ^ h);
+      uint64_t dh = ~(d ^ h) & (d ^ b) & (h ^ f);
+      uint64_t hf = ~(h ^ f) & (h ^ d) & (f ^ b);
+
+      uint64_t e0 = pick(db, d, e);
+      uint64_t e1 = pick((db & (e ^ c)) | (bf & (e ^ a)), b, e);
+      uint64_t e2 = pick(bf, f, e);
+      uint64_t e3 = pick((db & (e ^ g)) | (dh & (e ^ a)), d, e);
+      uint64_t e5 = pick((bf & (e ^ i)) | (hf & (e ^ c)), f, e);
+      uint64_t e6 = pick(dh, d, e);
+      uint64_t e7 = pick((dh & (e ^ i)) | (hf & (e ^ g)), h, e);
+      uint64_t e8 = pick(hf, f, e);
+
+      interleave3(e0, e1, e2, rows[0] + w * 3);
+      interleave3(e3, e, e5, rows[1] + w * 3);
+      interleave3(e6, e7, e8, rows[2] + w * 3);
+    }
+  }
+}
+
+void ScaleNearest(const uint8_t *rgb, int width, int height, int factor,
+                  uint8_t *out) {
+  size_t stride = (size_t)width * factor * 3;
+
+  for (int y = 0; y < height; y++) {
+    uint8_t *row = out + y * factor * stride;
+    const uint8_t *pixel = rgb + y * width * 3;
+
+    // One row, then copies of it
+    uint8_t *at = row;
+    for (int x = 0; x < width; x++, pixel += 3) {
+      for (int k = 0; k < factor; k++, at += 3) {
+        memcpy(at, pixel, 3);
+      }
+    }
+
+    for (int k = 1; k < factor; k++) {
+      memcpy(row + k * stride, row, stride);
+    }
+  }
+}
+} // namespace chip8
@@ -0,0 +1,212 @@
+#include <cctype>
+#include <climits>
+#include <iostream>
+#include <sstream>
+#include <stdlib.h>
+#include <string>
+
+#include "watch.hpp"
+
+namespace chip8 {
+static bool parseNumber(const std::string &text, int &out) {
+  char *end;
+  long value = strtol(text.c_str(), &end, 0);
+  if (text.empty() || *end != '\0' || value < INT_MIN || value > INT_MAX) {
+    return false;
+  }
+
+  out = (int)value;
+  return true;
+}
+
+static uint64_t pagesOf(uint16_t address, int size) {
+  return 1ull << ((address >> 6) & 63) |
+         1ull << (((address + size - 1) >> 6) & 63);
+}
+
+bool Watch::Add(const std::string &expression, WatchSignal signal,
+                float reward) {
+  std::istringstream fields(expression);
+  std::string source, condition, operand;
+  fields >> source >> condition >> operand;
+
+  Predicate p = {};
+  p.signal = signal;
+  p.reward = reward;
+
+  auto fail = [&](const std::string &why) {
+    std::cerr << "Watch '" << expression << "': " << why << std::endl;
+    return false;
+  };
+
+  // vX, mem[addr], bcd[addr] or bcd[i]
+  int address = 0;
+  if (source.size() == 2 && (source[0] == 'v' || source[0] == 'V') &&
+      isxdigit(source[1])) {
+    p.source = Source::Register;
+    p.address = std::stoi(source.substr(1), nullptr, 16);
+  } else if (source.rfind("mem[", 0) == 0 && source.back() == ']' &&
+             parseNumber(source.substr(4, source.size() - 5), address)) {
+    p.source = Source::Memory;
+    p.address = address;
+    p.pages = pagesOf(address, 1);
+  } else if (source == "bcd[i]" || source == "bcd[I]") {
+    p.source = Source::BcdAtIndex;
+    p.pages = ~0ull; // Wherever the last FX33 wrote
+  } else if (source.rfind("bcd[", 0) == 0 && source.back() == ']' &&
+             parseNumber(source.substr(4, source.size() - 5), address)) {
+    p.source = Source::Bcd;
+    p.address = address;
+    p.pages = pagesOf(address, 3);
+  } else {
+    return fail("expected vX, mem[addr], bcd[addr] or bcd[i]");
+  }
+
+  if (address < 0 || (p.source == Source::Memory && address > 0xFFF) ||
+      (p.source == Source::Bcd && address > 0xFFD)) {
+    return fail("address out of memory");
+  }
+
+  static const std::pair<const char *, Condition> conditions[] = {
+      {"changed", Condition::Changed},     {"increased", Condition::Increased},
+      {"decreased", Condition::Decreased}, {"==", Condition::Equal},
+      {"!=", Condition::NotEqual},         {"<", Condition::Less},
+      {"<=", Condition::LessEqual},        {">", Condition::Greater},
+      {">=", Condition::GreaterEqual},
+  };
+
+  bool found = false;
+  for (auto &[name, value] : conditions) {
+    if (condition == name) {
+      p.condition = value;
+      found = true;
+    }
+  }
+
+  if (!found) {
+    return fail("unknown condition '" + condition + "'");
+  }
+
+  bool comparison = p.condition >= Condition::Equal;
+  if (comparison != parseNumber(operand, p.operand)) {
+    return fail(comparison ? "comparison needs a number"
+                           : "unexpected '" + operand + "'");
+  }
+
+  predicates.push_back(p);
+  pages |= p.pages;
+  registers |= p.source == Source::Register;
+  return true;
+}
+
+int Watch::value(const Predicate &p, const Chip8 &c8) {
+  switch (p.source) {
+  case Source::Register:
+    return c8.reg[p.address];
+  case Source::Memory:
+    return c8.mem[p.address & 0xFFF];
+  case Source::Bcd:
+  case Source::BcdAtIndex: {
+    uint16_t a = p.source == Source::Bcd ? p.address : c8.bcdAddress;
+    return c8.mem[a & 0xFFF] * 100 + c8.mem[(a + 1) & 0xFFF] * 10 +
+           c8.mem[(a + 2) & 0xFFF];
+  }
+  }
+
+  return 0;
+}
+
+bool Watch::compare(const Predicate &p, int value) {
+  switch (p.condition) {
+  case Condition::Equal:
+    return value == p.operand;
+  case Condition::NotEqual:
+    return value != p.operand;
+  case Condition::Less:
+    return value < p.operand;
+  case Condition::LessEqual:
+    return value <= p.operand;
+  case Condition::Greater:
+    return value > p.operand;
+  case Condition::GreaterEqual:
+    return value >= p.operand;
+  default:
+    return false;
+  }
+}
+
+void Watch::Attach(Chip8 &c8, WatchState &state) const {
+  c8.watchPages = pages;
+  c8.dirtyPages = 0;
+
+  state.seen.resize(predicates.size());
+  for (size_t i = 0; i < predicates.size(); i++) {
+    auto &s = state.seen[i];
+    s.address = c8.bcdAddress;
+    s.last = value(predicates[i], c8);
+    s.held = compare(predicates[i], s.last);
+  }
+}
+
+WatchResult Watch::Evaluate(Chip8 &c8, WatchState &state) const {
+  WatchResult result;
+
+  uint64_t dirty = c8.dirtyPages;
+  if (dirty == 0 && !registers) {
+    return result;
+  }
+
+  c8.dirtyPages = 0;
+
+  // Predicates added after state was attached wait for the next Attach
+  for (size_t i = 0; i < state.seen.size(); i++) {
+    auto &p = predicates[i];
+    auto &s = state.seen[i];
+
+    if (p.source != Source::Register && (p.pages & dirty) == 0) {
+      continue;
+    }
+
+    int now = value(p, c8);
+
+    // FX33 writing somewhere else starts a new value to follow, it is not a
+    // change of the old one
+    if (p.source == Source::BcdAtIndex && s.address != c8.bcdAddress) {
+      s.address = c8.bcdAddress;
+      s.last = now;
+      s.held = compare(p, now);
+      continue;
+    }
+
+    bool fired;
+    switch (p.condition) {
+    case Condition::Changed:
+      fired = now != s.last;
+      break;
+    case Condition::Increased:
+      fired = now > s.last;
+      break;
+    case Condition::Decreased:
+      fired = now < s.last;
+      break;
+    default: {
+      bool holds = compare(p, now);
+      fired = holds && !s.held;
+      s.held = holds;
+    }
+    }
+
+    s.last = now;
+
+    if (fired) {
+      if (p.signal == WatchSignal::Reward) {
+        result.reward += p.reward;
+      } else {
+        result.done = true;
+      }
+    }
+  }
+
+  return result;
+}
+} // namespace chip8